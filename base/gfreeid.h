@@ -73,6 +73,32 @@
     _GFREEID_INITSLOTS((gfi)->p, 0, cap);       \
 } while (0);
 
+// shrink the cap by half while the used slots all in the lower quarter,
+// then rebuild the free list in order of id, so the lower slot alloc first,
+// and the upper slots keep free for next shrink, return the new cap
+#define GFREEID_SHRINK(type, gfi, mincap) ({ \
+    int _top = (gfi)->cap - 1;                                  \
+    while (_top >= 0 && !(gfi)->p[_top].used)                   \
+        --_top;                                                 \
+    int _cap = (gfi)->cap;                                      \
+    while (_cap/2 >= (mincap) && _top < _cap/4)                 \
+        _cap /= 2;                                              \
+    if (_cap < (gfi)->cap) {                                    \
+        (gfi)->p = realloc((gfi)->p, sizeof(struct type) * _cap);\
+        (gfi)->cap = _cap;                                      \
+    }                                                           \
+    (gfi)->freep = NULL;                                        \
+    int _i;                                                     \
+    for (_i=_cap-1; _i>=0; --_i) {                              \
+        struct type* _s = &(gfi)->p[_i];                        \
+        if (!_s->used) {                                        \
+            _s->id = (gfi)->freep ? (gfi)->freep - (gfi)->p : -1;\
+            (gfi)->freep = _s;                                  \
+        }                                                       \
+    }                                                           \
+    _cap;                                                       \
+})
+
 #define GFREEID_FINI(type, gfi) do { \
     free((gfi)->p);       \
     (gfi)->p = NULL;      \
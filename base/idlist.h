@@ -0,0 +1,59 @@
+#ifndef __idlist_h__
+#define __idlist_h__
+
+/*
+ * intrusive double link list of the array elements, link by index,
+ * so the array can realloc, the element need fields: int lprev, lnext.
+ * push to back with the time, then the list is in order of time,
+ * the timeout check just pop from the head
+ */
+
+#define IDLIST_LINK \
+    int lprev;      \
+    int lnext;      \
+
+struct idlist {
+    int head;
+    int tail;
+    int n;
+};
+
+#define IDLIST_INIT(l) do { \
+    (l)->head = -1; \
+    (l)->tail = -1; \
+    (l)->n = 0;     \
+} while (0)
+
+#define IDLIST_HEAD(l) ((l)->head)
+#define IDLIST_COUNT(l) ((l)->n)
+
+#define IDLIST_PUSHBACK(l, p, id) do { \
+    int _id = (id);                         \
+    (p)[_id].lprev = (l)->tail;             \
+    (p)[_id].lnext = -1;                    \
+    if ((l)->tail >= 0)                     \
+        (p)[(l)->tail].lnext = _id;         \
+    else                                    \
+        (l)->head = _id;                    \
+    (l)->tail = _id;                        \
+    (l)->n++;                               \
+} while (0)
+
+#define IDLIST_REMOVE(l, p, id) do { \
+    int _id = (id);                         \
+    int _prev = (p)[_id].lprev;             \
+    int _next = (p)[_id].lnext;             \
+    if (_prev >= 0)                         \
+        (p)[_prev].lnext = _next;           \
+    else                                    \
+        (l)->head = _next;                  \
+    if (_next >= 0)                         \
+        (p)[_next].lprev = _prev;           \
+    else                                    \
+        (l)->tail = _prev;                  \
+    (p)[_id].lprev = -1;                    \
+    (p)[_id].lnext = -1;                    \
+    (l)->n--;                               \
+} while (0)
+
+#endif
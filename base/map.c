@@ -15,35 +15,47 @@ _str_hash(const char* key) {
 }
 
 /*
- * idmap
+ * idmap, open addressing with robin hood probing,
+ * dist is probe distance + 1, 0 means empty slot,
+ * hash by the low bits as ids are mostly sequential
  */
-struct idelement {
+struct idslot {
     uint32_t key;
+    uint32_t dist;
     void* pointer;
-    struct idelement* next;
 };
 
 struct idmap {
     uint32_t used;
     uint32_t cap;
-    struct idelement** slots;
+    struct idslot* slots;
 };
 
+static inline uint32_t
+_id_hash(struct idmap* self, uint32_t key) {
+    return key & (self->cap - 1);
+}
+
+static void
+_idmap_alloc(struct idmap* self, uint32_t cap) {
+    self->cap = cap;
+    self->slots = malloc(sizeof(struct idslot) * cap);
+    memset(self->slots, 0, sizeof(struct idslot) * cap);
+}
+
+#define IDMAP_MINCAP 8
+
 struct idmap* 
 idmap_create(uint32_t cap) {
     uint32_t tmp;
-    tmp = 2;
+    tmp = IDMAP_MINCAP;
     while (tmp < cap)
         tmp *= 2;
     cap = tmp;
 
     struct idmap* m = malloc(sizeof(*m));
-
-    struct idelement** slots = malloc(sizeof(struct idelement*) * cap);
-    memset(slots, 0, sizeof(struct idelement*) * cap);
-    m->slots = slots;
+    _idmap_alloc(m, cap);
     m->used = 0;
-    m->cap = cap;
     return m;
 }
 
@@ -52,103 +64,162 @@ idmap_free(struct idmap* self, void (*cb)(void* value)) {
     if (self == NULL)
         return;
    
-    struct idelement* e, *tmp;
     uint32_t i;
-    for (i=0; i<self->cap; ++i) {
-        e = self->slots[i];
-        while (e) {
-            tmp = e;
-            e = e->next;
-            if (cb) {
-                cb(tmp->pointer);
+    if (cb) {
+        for (i=0; i<self->cap; ++i) {
+            if (self->slots[i].dist) {
+                cb(self->slots[i].pointer);
             }
-            free(tmp);
         }
     }
     free(self->slots);
     free(self);
 }
 
+static int
+_idmap_index(struct idmap* self, uint32_t key) {
+    uint32_t mask = self->cap - 1;
+    uint32_t i = _id_hash(self, key);
+    uint32_t dist = 1;
+    for (;;) {
+        struct idslot* s = &self->slots[i];
+        if (s->dist < dist) {
+            return -1;
+        }
+        if (s->key == key) {
+            return i;
+        }
+        i = (i+1) & mask;
+        dist++;
+    }
+}
+
 void* 
 idmap_find(struct idmap* self, uint32_t key) {
-    uint32_t hash = key & (self->cap - 1);
-    struct idelement* e = self->slots[hash];
-    while (e) {
-        if (e->key == key) {
-            return e->pointer;
+    int i = _idmap_index(self, key);
+    return i >= 0 ? self->slots[i].pointer : NULL;
+}
+
+// return 1 if insert new, 0 if the key exist and replace the pointer
+static int
+_idmap_place(struct idmap* self, uint32_t key, void* pointer) {
+    uint32_t mask = self->cap - 1;
+    uint32_t i = _id_hash(self, key);
+    struct idslot cur = { key, 1, pointer };
+    struct idslot* s;
+    // the key must be in front of the first poorer slot
+    for (;;) {
+        s = &self->slots[i];
+        if (s->dist < cur.dist)
+            break;
+        if (s->key == key) {
+            s->pointer = pointer;
+            return 0;
         }
-        e = e->next;
+        i = (i+1) & mask;
+        cur.dist++;
+    }
+    for (;;) {
+        s = &self->slots[i];
+        if (s->dist == 0) {
+            *s = cur;
+            return 1;
+        }
+        if (s->dist < cur.dist) {
+            // take from the rich
+            struct idslot tmp = *s;
+            *s = cur;
+            cur = tmp;
+        }
+        i = (i+1) & mask;
+        cur.dist++;
     }
-    return NULL;
 }
 
 static void
 _idmap_rehash(struct idmap* self) {
+    struct idslot* old = self->slots;
     uint32_t oldcap = self->cap;
-    self->cap *= 2;
-    self->slots = realloc(self->slots, sizeof(struct idelement*) * self->cap);
-    memset(self->slots + oldcap, 0, sizeof(struct idelement*) * (self->cap - oldcap));
-    struct idelement* e;
-    struct idelement* next;
-    uint32_t hash;
-    int i;
+    _idmap_alloc(self, oldcap * 2);
+    uint32_t i;
     for (i=0; i<oldcap; ++i) {
-        e = self->slots[i];
-        self->slots[i] = NULL;
-        while (e) {
-            next = e->next;
-            hash = e->key & (self->cap-1);
-            e->next = self->slots[hash];
-            self->slots[hash] = e;
-            e = next;
+        if (old[i].dist) {
+            _idmap_place(self, old[i].key, old[i].pointer);
         }
     }
+    free(old);
 }
 
+// replace the pointer if key exist
 void 
 idmap_insert(struct idmap* self, uint32_t key, void* pointer) {
-    if (self->used >= self->cap) {
+    if ((self->used+1) * 4 > self->cap * 3) {
         _idmap_rehash(self); 
     }
-    uint32_t hash = key & (self->cap - 1);
-    struct idelement* e = malloc(sizeof(*e));
-    e->key = key;
-    e->pointer = pointer;
-    e->next = self->slots[hash];
-    self->slots[hash] = e;
-    self->used++;
+    self->used += _idmap_place(self, key, pointer);
+}
+
+// backward shift, no tombstone
+static void
+_idmap_erase(struct idmap* self, uint32_t i) {
+    uint32_t mask = self->cap - 1;
+    uint32_t next = (i+1) & mask;
+    while (self->slots[next].dist > 1) {
+        self->slots[i] = self->slots[next];
+        self->slots[i].dist--;
+        i = next;
+        next = (next+1) & mask;
+    }
+    self->slots[i].dist = 0;
+    self->slots[i].pointer = NULL;
+    self->used--;
 }
 
 void* 
 idmap_remove(struct idmap* self, uint32_t key) {
-    void* ret;
-    uint32_t hash = key & (self->cap - 1);
-    struct idelement** p = &self->slots[hash];
-    struct idelement* e = *p;
-    while (e) {
-        if (e->key == key) {
-            *p = e->next;
-            ret = e->pointer;
-            free(e);
-            self->used--;
-            return ret;
-        }
-        p = &e->next;
-        e = *p;
+    int i = _idmap_index(self, key);
+    if (i < 0) {
+        return NULL;
     }
-    return NULL;
+    void* ret = self->slots[i].pointer;
+    _idmap_erase(self, i);
+    return ret;
 }
 
 void 
 idmap_foreach(struct idmap* self, void (*cb)(uint32_t key, void* value, void* ud), void* ud) {
-    struct idelement* e, *tmp;
+    struct idslot* s;
     uint32_t i;
     for (i=0; i<self->cap; ++i) {
-        e = self->slots[i];
-        while (e) {
-            tmp = e;
-            e = e->next;
-            cb(tmp->key, tmp->pointer, ud);
+        s = &self->slots[i];
+        if (s->dist) {
+            cb(s->key, s->pointer, ud);
+        }
+    }
+}
+
+void
+idmap_foreach_remove(struct idmap* self, int (*cb)(uint32_t key, void* value, void* ud), void* ud) {
+    if (self->used == 0)
+        return;
+    // start at the head of a cluster, so the backward shift never
+    // move a visited slot into the part not visited
+    uint32_t mask = self->cap - 1;
+    uint32_t start = 0;
+    while (self->slots[start].dist > 1) {
+        start++;
+    }
+    uint32_t n = 0;
+    while (n < self->cap) {
+        uint32_t i = (start + n) & mask;
+        struct idslot* s = &self->slots[i];
+        if (s->dist && cb(s->key, s->pointer, ud)) {
+            _idmap_erase(self, i);
+            // slot i now hold the next one of cluster, if any
+            if (s->dist == 0) 
+                n++;
+        } else {
+            n++;
         }
     }
 }
@@ -9,7 +9,10 @@ void idmap_free(struct idmap* self, void (*cb)(void* value));
 void* idmap_find(struct idmap* self, uint32_t key);
 void idmap_insert(struct idmap* self, uint32_t key, void* pointer);
 void* idmap_remove(struct idmap* self, uint32_t key);
+// do not insert or remove in cb, use idmap_foreach_remove instead
 void idmap_foreach(struct idmap* self, void (*cb)(uint32_t key, void* value, void* ud), void* ud);
+// remove the element if cb return nonzero
+void idmap_foreach_remove(struct idmap* self, int (*cb)(uint32_t key, void* value, void* ud), void* ud);
 
 struct strmap;
 struct strmap* strmap_create(uint32_t cap);
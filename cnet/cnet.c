@@ -71,6 +71,9 @@ _read(struct net_message* nm) {
             memcpy(&msg->cli_base, one, UM_CLI_SZ(one));
 
             _handleum(id, nm->ut, msg);
+            if (net_socket_isclosed(N, id)) {
+                return;
+            }
             if (++step > 10) {
                 net_dropread(N, id, nread-buf.sz);
                 return;
@@ -171,7 +174,7 @@ cnet_init(int cmax) {
             _onconnerrdef,
             _onsockerrdef,
             _handleumdef);
-    N = net_create(cmax, 64*1024);
+    N = net_create(cmax, 64*1024, NET_POLLER_EPOLL);
     return N != NULL ? 0 : 1;
 
 }
@@ -37,7 +37,20 @@ function def_node(name, sid)
     node_sub  = node.sub
 
     sc_loglevel = "INFO"
+    -- log lines queue to the writer thread, drop or block if full, 0 write in place
+    sc_log_ring = 4096
+    sc_log_overflow = "drop"
     sc_connmax = node.conn
+    -- multi reactor, sc_connmax is per reactor
+    -- bit of socket ut send once a loop (1 the node link), flush early over corkmax
+    sc_net_cork = 1
+    sc_net_corkmax = 65536
+    -- epoll edge trigger, accept and read until EAGAIN, the budget stop read is requeue
+    sc_net_edge = 0
+    --sc_reactor = 2
+    --sc_reactor_affinity = "gate:1,forward:1"
+    -- loop and service callback profile, see cmdctl stats
+    sc_profile = 1
     sc_service = "log,dispatcher,node"
     if name == "center" then
         sc_service = sc_service .. ",centers,cmdctl,cmds"
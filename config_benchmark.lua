@@ -11,3 +11,4 @@ benchmark_query=100000     -- query times
 --benchmark_query_first=10000
 benchmark_packet_size=16 -- packet size in bytes
 benchmark_packet_split=2 -- packet split to count, then send one after another by interval 10ms
+benchmark_read_budget=10 -- max messages handle in one read event
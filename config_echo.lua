@@ -8,6 +8,7 @@ gate_ip="192.168.1.140"
 gate_port=18999
 gate_clientmax=10000
 gate_clientlive=30
+gate_read_budget=10 -- max messages handle in one read event
 gate_need_verify=0
 --gate_need_load=0
 gate_handler="echo"
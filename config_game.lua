@@ -5,3 +5,7 @@ cmdctl_handler="cmdctlgame"
 tplt_handler="tpltgame"
 
 sc_service=sc_service..",cmdctlgame,tpltgame,game"
+game_load_report=5 -- second, report the load to world for placement
+game_genmap_thread=2 -- map generate thread, 0 generate in the loop
+game_genmap_cache=64 -- cache the generated map by (map, seed), only if game_genmap_seed > 0
+game_genmap_seed=0 -- 0 seed by room key and no cache, n to share n layouts of one map
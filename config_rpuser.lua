@@ -5,3 +5,4 @@ sc_service=sc_service..",redisproxy"
 redis_ip="127.0.0.1" 
 redis_port=6379 
 redis_auth=""
+--redis_connmax=4 -- connection pool, query route by key
@@ -9,3 +9,9 @@ tplt_handler="tpltworld"
 world_gmax=10 
 world_cmax_pergate=10000 
 world_hmax_pergate=11000 
+world_save_interval=60 -- second, write the dirty players behind
+-- game placement score by the load report: rooms, clients, tick p99 (ms), send queue (KB)
+node_weight_room=10
+node_weight_client=1
+node_weight_tick=20
+node_weight_sendq=1
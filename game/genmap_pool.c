@@ -0,0 +1,261 @@
+#include "genmap_pool.h"
+#include "genmap.h"
+#include "roommap.h"
+#include "tplt_struct.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+struct genmap_job {
+    struct genmap_job* next;
+    const struct map_tplt* tplt;
+    uint32_t mapid;
+    struct roommap* m;
+    uint32_t seed;
+    struct genmap* map;
+    genmap_pool_cb cb;
+    void* ud;
+};
+
+struct jobqueue {
+    struct genmap_job* head;
+    struct genmap_job* tail;
+};
+
+struct genmap_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct jobqueue todo;
+    struct jobqueue done;
+    int quit;
+    int nthread;
+    pthread_t* threads;
+    int pending;
+    // lru cache, head is the newest
+    int cachemax;
+    int ncache;
+    struct genmap_item* head;
+    struct genmap_item* tail;
+};
+
+static inline void
+_push(struct jobqueue* q, struct genmap_job* job) {
+    job->next = NULL;
+    if (q->tail)
+        q->tail->next = job;
+    else
+        q->head = job;
+    q->tail = job;
+}
+
+static inline struct genmap_job*
+_pop(struct jobqueue* q) {
+    struct genmap_job* job = q->head;
+    if (job) {
+        q->head = job->next;
+        if (q->head == NULL)
+            q->tail = NULL;
+    }
+    return job;
+}
+
+static void*
+_worker(void* ud) {
+    struct genmap_pool* self = ud;
+    struct genmap_job* job;
+    pthread_mutex_lock(&self->lock);
+    for (;;) {
+        while (self->todo.head == NULL && !self->quit)
+            pthread_cond_wait(&self->cond, &self->lock);
+        if (self->quit)
+            break;
+        job = _pop(&self->todo);
+        pthread_mutex_unlock(&self->lock);
+        job->map = genmap_create(job->tplt, job->m, job->seed);
+        pthread_mutex_lock(&self->lock);
+        _push(&self->done, job);
+    }
+    pthread_mutex_unlock(&self->lock);
+    return NULL;
+}
+
+struct genmap_pool*
+genmap_pool_create(int nthread, int cachemax) {
+    struct genmap_pool* self = malloc(sizeof(*self));
+    memset(self, 0, sizeof(*self));
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+    self->cachemax = cachemax > 0 ? cachemax : 0;
+    if (nthread > 0) {
+        self->threads = malloc(sizeof(pthread_t) * nthread);
+        int i;
+        for (i=0; i<nthread; ++i) {
+            if (pthread_create(&self->threads[i], NULL, _worker, self))
+                break;
+        }
+        self->nthread = i;
+    }
+    return self;
+}
+
+static void
+_unlink(struct genmap_pool* self, struct genmap_item* item) {
+    if (item->prev)
+        item->prev->next = item->next;
+    else
+        self->head = item->next;
+    if (item->next)
+        item->next->prev = item->prev;
+    else
+        self->tail = item->prev;
+    item->prev = item->next = NULL;
+    self->ncache--;
+}
+
+static void
+_linkhead(struct genmap_pool* self, struct genmap_item* item) {
+    item->prev = NULL;
+    item->next = self->head;
+    if (self->head)
+        self->head->prev = item;
+    else
+        self->tail = item;
+    self->head = item;
+    self->ncache++;
+}
+
+void
+genmap_pool_release(struct genmap_pool* self, struct genmap_item* item) {
+    if (--item->ref > 0)
+        return;
+    genmap_free(item->map);
+    roommap_free(item->m);
+    free(item);
+}
+
+static void
+_freejobs(struct jobqueue* q) {
+    struct genmap_job* job;
+    while ((job = _pop(q))) {
+        if (job->map)
+            genmap_free(job->map);
+        roommap_free(job->m);
+        job->cb(job->ud, NULL);
+        free(job);
+    }
+}
+
+void
+genmap_pool_free(struct genmap_pool* self) {
+    if (self == NULL)
+        return;
+    pthread_mutex_lock(&self->lock);
+    self->quit = 1;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+    int i;
+    for (i=0; i<self->nthread; ++i) {
+        pthread_join(self->threads[i], NULL);
+    }
+    free(self->threads);
+    _freejobs(&self->todo);
+    _freejobs(&self->done);
+    while (self->head) {
+        struct genmap_item* item = self->head;
+        _unlink(self, item);
+        genmap_pool_release(self, item);
+    }
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+}
+
+struct genmap_item*
+genmap_pool_find(struct genmap_pool* self, uint32_t mapid, 
+        struct roommap* m, uint32_t seed) {
+    struct genmap_item* item = self->head;
+    while (item) {
+        struct genmap_item* next = item->next;
+        if (item->mapid == mapid) {
+            if (item->m != m) {
+                _unlink(self, item);
+                genmap_pool_release(self, item);
+            } else if (item->seed == seed) {
+                _unlink(self, item);
+                _linkhead(self, item);
+                item->ref++;
+                return item;
+            }
+        }
+        item = next;
+    }
+    return NULL;
+}
+
+void
+genmap_pool_request(struct genmap_pool* self,
+        const struct map_tplt* tplt, struct roommap* m, uint32_t seed,
+        genmap_pool_cb cb, void* ud) {
+    struct genmap_job* job = malloc(sizeof(*job));
+    job->tplt = tplt;
+    job->mapid = tplt->id;
+    job->m = roommap_grab(m);
+    job->seed = seed;
+    job->map = NULL;
+    job->cb = cb;
+    job->ud = ud;
+    self->pending++;
+    if (self->nthread == 0) {
+        job->map = genmap_create(tplt, m, seed);
+        _push(&self->done, job);
+        return;
+    }
+    pthread_mutex_lock(&self->lock);
+    _push(&self->todo, job);
+    pthread_cond_signal(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+}
+
+static struct genmap_item*
+_newitem(struct genmap_pool* self, struct genmap_job* job) {
+    struct genmap_item* item = malloc(sizeof(*item));
+    memset(item, 0, sizeof(*item));
+    item->ref = 1;
+    item->mapid = job->mapid;
+    item->m = roommap_grab(job->m);
+    item->seed = job->seed;
+    item->map = job->map;
+    if (self->cachemax > 0) {
+        item->ref++;
+        _linkhead(self, item);
+        if (self->ncache > self->cachemax) {
+            struct genmap_item* last = self->tail;
+            _unlink(self, last);
+            genmap_pool_release(self, last);
+        }
+    }
+    return item;
+}
+
+int
+genmap_pool_poll(struct genmap_pool* self) {
+    struct genmap_job* job;
+    pthread_mutex_lock(&self->lock);
+    job = self->done.head;
+    self->done.head = self->done.tail = NULL;
+    pthread_mutex_unlock(&self->lock);
+
+    while (job) {
+        struct genmap_job* next = job->next;
+        struct genmap_item* item = NULL;
+        if (job->map) {
+            item = _newitem(self, job);
+        }
+        roommap_free(job->m);
+        self->pending--;
+        job->cb(job->ud, item);
+        free(job);
+        job = next;
+    }
+    return self->pending;
+}
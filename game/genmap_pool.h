@@ -0,0 +1,45 @@
+#ifndef __genmap_pool_h__
+#define __genmap_pool_h__
+
+#include <stdint.h>
+
+struct map_tplt;
+struct roommap;
+struct genmap;
+struct genmap_pool;
+
+// a generated map shared by the rooms of same (map id, seed)
+struct genmap_item {
+    int ref;
+    uint32_t mapid;
+    struct roommap* m;
+    uint32_t seed;
+    struct genmap* map;
+    struct genmap_item* prev; // lru link of the cache
+    struct genmap_item* next;
+};
+
+// item is NULL if generate fail
+typedef void (*genmap_pool_cb)(void* ud, struct genmap_item* item);
+
+/*
+ * generate the room map in worker threads, the result is deliver by
+ * genmap_pool_poll in the owner thread, all functions must call in the owner.
+ * nthread 0 generate in genmap_pool_request, the pending cb is call with NULL in free
+ */
+struct genmap_pool* genmap_pool_create(int nthread, int cachemax);
+void genmap_pool_free(struct genmap_pool* self);
+
+// return the cached item with a ref, or NULL,
+// the item of the old roommap (reload) is drop from the cache
+struct genmap_item* genmap_pool_find(struct genmap_pool* self, uint32_t mapid, 
+        struct roommap* m, uint32_t seed);
+// tplt must keep valid until cb, m is grab by the pool
+void genmap_pool_request(struct genmap_pool* self,
+        const struct map_tplt* tplt, struct roommap* m, uint32_t seed,
+        genmap_pool_cb cb, void* ud);
+// call cb of the done request, return the pending count
+int  genmap_pool_poll(struct genmap_pool* self);
+void genmap_pool_release(struct genmap_pool* self, struct genmap_item* item);
+
+#endif
@@ -3,6 +3,12 @@
 #include <string.h>
 #include <stdio.h>
 #include <stddef.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 struct readptr {
     char* bptr;
@@ -42,7 +48,7 @@ _check(struct roommap* self, int sz) {
     uint8_t lastoff = curoff;
 
     struct readptr rp = { self->data, self->data, 
-                          sz - sizeof(self->header) };
+                          sz - sizeof(*self->header) };
     for (i=0; i<depth; ++i) {
         if (_rp_read(&rp, &th, sizeof(th))) {
             return 1;
@@ -66,8 +72,6 @@ _check(struct roommap* self, int sz) {
     return 0;
 }
 
-#define MMAP_SIZE(sz) (offsetof(struct roommap, header) + (sz))
-
 static int
 _build(struct roommap* self) {
     uint16_t depth = ROOMMAP_DEPTH(self);
@@ -81,54 +85,89 @@ _build(struct roommap* self) {
     return 0;
 }
 
+static struct roommap*
+_create(void* p, int sz, size_t mapsz) {
+    struct roommap* self = malloc(sizeof(*self));
+    memset(self, 0, sizeof(*self));
+    self->header = p;
+    self->data = (char*)p + sizeof(struct roommap_header);
+    self->mapsz = mapsz;
+    self->ref = 1;
+    if (sz <= sizeof(struct roommap_header) || 
+        _check(self, sz) || 
+        _build(self)) {
+        roommap_free(self);
+        return NULL;
+    }
+    return self;
+}
+
+#ifndef _WIN32
+// map the file readonly, so the processes on one host share the page cache
+struct roommap*
+roommap_create(const char* file) {
+    int fd = open(file, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= sizeof(struct roommap_header)) {
+        close(fd);
+        return NULL;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    return _create(p, st.st_size, st.st_size);
+}
+#else
 struct roommap*
 roommap_create(const char* file) {
     FILE* fp = fopen(file, "rb");
-
+    if (fp == NULL) {
+        return NULL;
+    }
     fseek(fp, 0, SEEK_END);
     int fsize = ftell(fp); 
-
-    struct roommap* self = (struct roommap*)malloc(MMAP_SIZE(fsize));
-    memset(self, 0, sizeof(*self));
-    fseek(fp, 0, SEEK_SET);
-    if (fread(&self->header, fsize, 1, fp) != 1) {
-        free(self);
+    if (fsize <= (int)sizeof(struct roommap_header)) {
         fclose(fp);
         return NULL;
     }
-    fclose(fp);
-
-    if (_check(self, fsize)) {
-        free(self);
-        return NULL;
-    }
-    if (_build(self)) {
-        free(self);
+    void* p = malloc(fsize);
+    fseek(fp, 0, SEEK_SET);
+    if (fread(p, fsize, 1, fp) != 1) {
+        free(p);
+        fclose(fp);
         return NULL;
     }
-    return self;
+    fclose(fp);
+    return _create(p, fsize, 0);
 }
+#endif
 
 struct roommap*
 roommap_createfromstream(void* stream, int sz) {
     if (sz <= sizeof(struct roommap_header)) {
         return NULL;
     }
-    struct roommap* self = (struct roommap*)malloc(MMAP_SIZE(sz));
-    memset(self, 0, sizeof(*self));
-    memcpy(&self->header, stream, sz);
-    if (_check(self, sz)) {
-        free(self);
-        return NULL;
-    }
-    if (_build(self)) {
-        free(self);
-        return NULL;
-    }
-    return self;
+    void* p = malloc(sz);
+    memcpy(p, stream, sz);
+    return _create(p, sz, 0);
 }
 
 void
 roommap_free(struct roommap* self) {
+    if (--self->ref > 0)
+        return;
+#ifndef _WIN32
+    if (self->mapsz > 0) {
+        munmap(self->header, self->mapsz);
+        free(self);
+        return;
+    }
+#endif
+    free(self->header);
     free(self);
 }
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #pragma pack(1)
 
@@ -37,17 +38,19 @@ struct roommap_cell {
 struct roommap {
     struct roommap_typeid* typeid_entry;
     struct roommap_cell*   cell_entry;
-    struct roommap_header  header;
-    char data[];
+    struct roommap_header* header; // readonly, maybe mapped
+    char* data;
+    size_t mapsz; // 0 if header is malloc
+    int ref; // not atomic, grab and free in one thread
 };
 
 #pragma pack()
 
-#define ROOMMAP_DEPTH(m)        (((m)->header.height+99)/100)
+#define ROOMMAP_DEPTH(m)        (((m)->header->height+99)/100)
 #define ROOMMAP_TID_HEADER(m)   ((struct roommap_typeid_header*)((m)->data))
 #define ROOMMAP_TID_ENTRY(m)    ((m)->typeid_entry)
 #define ROOMMAP_CELL_ENTRY(m)   ((m)->cell_entry)
-#define ROOMMAP_NCELL(m)        ((m)->header.height*(m)->header.width)
+#define ROOMMAP_NCELL(m)        ((m)->header->height*(m)->header->width)
 
 static inline struct roommap_typeidlist 
 roommap_gettypeidlist(struct roommap* self, uint16_t index) {
@@ -64,8 +67,14 @@ roommap_gettypeidlist(struct roommap* self, uint16_t index) {
     return tilist;
 }
 
+static inline struct roommap*
+roommap_grab(struct roommap* self) {
+    self->ref++;
+    return self;
+}
+
 struct roommap* roommap_create(const char* file);
 struct roommap* roommap_createfromstream(void* stream, int sz);
-void roommap_free(struct roommap* self);
+void roommap_free(struct roommap* self); // release one ref
 
 #endif
@@ -16,6 +16,8 @@ struct gate_client {
     int connid;
     int status;
     uint64_t active_time;
+    int lprev; // link of the status list, see idlist.h
+    int lnext;
 };
 
 // bind gate_client to msg
@@ -34,4 +36,11 @@ int sc_gate_maxclient();
 int sc_gate_usedclient();
 int sc_gate_clientid(struct gate_client* c);
 
+// the clients of each status are kept in order of active_time
+// update active_time, move to the tail, O(1)
+void sc_gate_activeclient(struct gate_client* c);
+// the oldest client of status which inactive more than timeout, or NULL,
+// the return client is active again, so the caller must handle it
+struct gate_client* sc_gate_expireclient(int status, uint64_t timeout);
+
 #endif
@@ -1,6 +1,8 @@
 #ifndef __sc_log_h__
 #define __sc_log_h__
 
+#include <stdint.h>
+
 #define LOG_DEBUG   0
 #define LOG_INFO    1
 #define LOG_WARNING 2
@@ -14,6 +16,8 @@ int sc_log_level();
 
 const char* sc_log_levelstr(int level);
 int  sc_log_setlevelstr(const char* level);
+// lines dropped since the log ring is full, see sc_log_overflow
+uint64_t sc_log_dropped();
 
 void sc_error(const char* fmt, ...)
 #ifdef __GNUC__
@@ -8,14 +8,22 @@
 int sc_net_listen(const char* addr, uint16_t port, int wbuffermax, int serviceid, int ut);
 int sc_net_connect(const char* addr, uint16_t port, bool block, int serviceid, int ut);
 void sc_net_poll(int timeout);
+void sc_net_flush();
 int sc_net_readto(int id, void* buf, int space, int* e);
 int sc_net_read(int id, bool force, struct mread_buffer* buf, int* e);
 void sc_net_dropread(int id, int sz);
 int sc_net_send(int id, void* data, int sz);
+int sc_net_sendv(int id, const struct iovec* iov, int cnt);
+int sc_net_multicast(const int* ids, int n, void* data, int sz);
 bool sc_net_close_socket(int id, bool force);
 int sc_net_max_socket();
+int64_t sc_net_sendbytes();
+int64_t sc_net_readbytes(int64_t* cached);
+int64_t sc_net_corkstat(int64_t* writes);
 const char* sc_net_error(int err);
 int sc_net_subscribe(int id, bool read);
+void sc_net_requeue(int id);
+int64_t sc_net_requeuestat();
 int sc_net_socket_address(int id, uint32_t* addr, uint16_t* port);
 int sc_net_socket_isclosed(int id);
 
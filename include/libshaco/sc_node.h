@@ -4,6 +4,15 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// the load report by node self, see sc_node_report
+struct sc_node_loadreport {
+    int rooms;
+    int clients;
+    int tick_avg;  // microsecond
+    int tick_p99;  // microsecond
+    int sendbytes; // bytes wait in the send queue
+};
+
 struct sc_node {
     union {
         struct {
@@ -17,7 +26,8 @@ struct sc_node {
     uint32_t gaddr;
     uint16_t gport;
     int connid;
-    int load;
+    int load; // the score of placement, less is better
+    struct sc_node_loadreport report;
 };
 
 #define HNODE_SID_MAX 0x3ff
@@ -52,5 +62,9 @@ const char* sc_strnode(const struct sc_node* node, char str[HNODESTR_MAX]);
 const struct sc_node* sc_node_minload(uint16_t tid);
 void sc_node_updateload(uint16_t id, int value);
 void sc_node_setload(uint16_t id, int value);
+// set the load by the weighted score of the report
+void sc_node_report(uint16_t id, const struct sc_node_loadreport* report);
+// the score of one more room, for the estimate before next report
+int  sc_node_roomload();
 
 #endif
@@ -0,0 +1,37 @@
+#ifndef __sc_profile_h__
+#define __sc_profile_h__
+
+#include <stdint.h>
+
+// loop phase
+#define PROF_WAIT  0 // net poll wait
+#define PROF_NET   1 // net event dispatch
+#define PROF_MAIL  2 // reactor mailbox dispatch
+#define PROF_TIMER 3 // timer dispatch, include service time
+#define PROF_DEFER 4
+#define PROF_FLUSH 5 // write of the corked sockets
+#define PROF_PHASE_MAX 6
+
+// service callback
+#define PROF_TIME    0
+#define PROF_SNET    1
+#define PROF_NODEMSG 2
+#define PROF_USERMSG 3
+#define PROF_CALL_MAX 4
+
+// monotonic microseconds, 0 if profile off (sc_profile=0)
+uint64_t sc_profile_begin();
+// call at the begin of each loop
+void sc_profile_loop();
+// record the phase from begin, return now for the next phase
+uint64_t sc_profile_phase(int phase, uint64_t begin);
+// the time is inclusive, it contain the nested service calls
+void sc_profile_service(int serviceid, int call, uint64_t begin);
+// the service tick fire lag milliseconds, against the register interval
+void sc_profile_lag(int serviceid, int interval, int lag);
+
+// dump text to buf, return the length
+int  sc_profile_dump(char* buf, int sz);
+void sc_profile_reset();
+
+#endif
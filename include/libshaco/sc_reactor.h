@@ -0,0 +1,30 @@
+#ifndef __sc_reactor_h__
+#define __sc_reactor_h__
+
+#include <stdbool.h>
+#include <sys/uio.h>
+
+// service not pinned, it run in the reactor which call it
+#define SC_REACTOR_ANY -1
+
+int  sc_reactor_count();
+int  sc_reactor_current();
+void sc_reactor_enter(int reactor);
+bool sc_reactor_multi();
+int  sc_reactor_wakeupfd(int reactor);
+void sc_reactor_wakeup(int reactor);
+
+// post to other reactor mailbox, the data will be copy
+void sc_reactor_post_nodemsg(int reactor, int serviceid, int id, void* msg, int sz);
+int  sc_reactor_post_sendv(int reactor, int connid, const struct iovec* iov, int cnt);
+
+// dispatch all mails of current reactor
+void sc_reactor_dispatch();
+
+// call cb once at the end of current loop, eg. flush the batched write
+void sc_reactor_defer(void (*cb)(void* ud), void* ud);
+// cancel the pending defer of (cb, ud), eg. the ud is free
+void sc_reactor_undefer(void (*cb)(void* ud), void* ud);
+void sc_reactor_dispatch_defer();
+
+#endif
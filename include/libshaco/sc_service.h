@@ -29,6 +29,7 @@ struct service_message {
 struct service {
     int serviceid; // >= 0, will not change since loaded
     bool inited;
+    int reactor; // see sc_reactor, SC_REACTOR_ANY if not pinned
     struct dlmodule dl;
 };
 
@@ -38,6 +39,8 @@ int service_reload(const char* name);
 int service_reload_byid(int serviceid);
 int service_query_id(const char* name);
 const char* service_query_name(int serviceid);
+int service_query_reactor(int serviceid);
+int service_count();
 
 int service_notify_service(int serviceid, struct service_message* sm);
 int service_notify_net(int serviceid, struct net_message* nm);
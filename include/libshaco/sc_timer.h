@@ -10,4 +10,9 @@ uint64_t sc_timer_now();
 uint64_t sc_timer_elapsed();
 uint64_t sc_timer_elapsed_real();
 
+// one-shot if interval <= 0, return timer id (> 0), 
+// add and del in the same reactor
+int64_t sc_timer_add(int delay, int interval, void (*cb)(void* ud), void* ud);
+void sc_timer_del(int64_t id);
+
 #endif
@@ -21,7 +21,10 @@ sc_check_init() {
         }
     }
 
-    int max = sc_getint("sc_connmax", 0) + 1000;
+    int reactor = sc_getint("sc_reactor", 1);
+    if (reactor < 1)
+        reactor = 1;
+    int max = sc_getint("sc_connmax", 0) * reactor + 1000;
     if (getrlimit(RLIMIT_NOFILE, &l) == -1) {
         sc_exit("getrlimit nofile fail: %s", strerror(errno));
     }
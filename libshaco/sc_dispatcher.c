@@ -10,6 +10,7 @@ static int _DISPATCHER = SERVICE_INVALID;
 int
 sc_dispatcher_subscribe(int serviceid, int msgid) {
     struct service_message sm;
+    sm.type = 0;
     sm.sessionid = serviceid; // reuse for serviceid
     sm.source = SERVICE_HOST;
     sm.sz = 0;
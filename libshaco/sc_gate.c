@@ -8,16 +8,20 @@
 #include "sc_env.h"
 #include "sc.h"
 #include "freeid.h"
+#include "idlist.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#define GATE_STATUS_MAX 4
+
 struct gate {
     int serviceid;
     int cmax;
     int used;
     struct freeid fi;
     struct gate_client* p;
+    struct idlist lists[GATE_STATUS_MAX]; // by status, FREE is not link
 };
 
 static struct gate* G = NULL;
@@ -31,9 +35,37 @@ sc_gate_prepare(int cmax, int hmax) {
     memset(c, 0, sizeof(struct gate_client) * cmax);
     G->p = c;
     freeid_init(&G->fi, cmax, hmax);
+    int i;
+    for (i=0; i<GATE_STATUS_MAX; ++i) {
+        IDLIST_INIT(&G->lists[i]);
+    }
     return 0;
 }
 
+static inline void
+_link(struct gate_client* c) {
+    IDLIST_PUSHBACK(&G->lists[c->status], G->p, c-G->p);
+}
+
+static inline void
+_unlink(struct gate_client* c) {
+    IDLIST_REMOVE(&G->lists[c->status], G->p, c-G->p);
+}
+
+// move to the tail of the new status list, active_time is now
+static void
+_setstatus(struct gate_client* c, int status) {
+    if (c->status != GATE_CLIENT_FREE)
+        _unlink(c);
+    c->status = status;
+    if (status != GATE_CLIENT_FREE) {
+        c->active_time = sc_timer_now();
+        _link(c);
+    } else {
+        c->active_time = 0;
+    }
+}
+
 static void
 _notify_gate_event(int event) {
     struct service_message sm;
@@ -56,8 +88,7 @@ sc_gate_acceptclient(int connid) {
     struct gate_client* c = &G->p[id];
     assert(c->status == GATE_CLIENT_FREE);
     c->connid = connid;
-    c->status = GATE_CLIENT_CONNECTED;
-    c->active_time = sc_timer_now();
+    _setstatus(c, GATE_CLIENT_CONNECTED);
     sc_net_subscribe(connid, true);
     G->used++;
     _notify_gate_event(GATE_EVENT_ONACCEPT); 
@@ -67,8 +98,7 @@ sc_gate_acceptclient(int connid) {
 void 
 sc_gate_loginclient(struct gate_client* c) { 
     if (c->status == GATE_CLIENT_CONNECTED) {
-        c->status = GATE_CLIENT_LOGINED; 
-        c->active_time = sc_timer_now();
+        _setstatus(c, GATE_CLIENT_LOGINED);
     }
 }
 
@@ -80,14 +110,12 @@ sc_gate_disconnclient(struct gate_client* c, bool force) {
     if (closed) {
         int id = freeid_free(&G->fi, c->connid);
         assert(id == (c-G->p));
-        c->status = GATE_CLIENT_FREE;
-        c->active_time = 0;
+        _setstatus(c, GATE_CLIENT_FREE);
         G->used--;
         _notify_gate_event(GATE_EVENT_ONDISCONN); 
     } else {
         if (c->status != GATE_CLIENT_LOGOUTED) {
-            c->status = GATE_CLIENT_LOGOUTED;
-            c->active_time = sc_timer_now();
+            _setstatus(c, GATE_CLIENT_LOGOUTED);
         }
     }
     return closed;
@@ -104,6 +132,31 @@ sc_gate_getclient(int connid) {
    return c;
 }
 
+void
+sc_gate_activeclient(struct gate_client* c) {
+    if (c->status == GATE_CLIENT_FREE)
+        return;
+    _unlink(c);
+    c->active_time = sc_timer_now();
+    _link(c);
+}
+
+struct gate_client*
+sc_gate_expireclient(int status, uint64_t timeout) {
+    if (status <= GATE_CLIENT_FREE || status >= GATE_STATUS_MAX)
+        return NULL;
+    int id = IDLIST_HEAD(&G->lists[status]);
+    if (id < 0)
+        return NULL;
+    struct gate_client* c = &G->p[id];
+    uint64_t now = sc_timer_now();
+    if (now > c->active_time && now - c->active_time > timeout) {
+        sc_gate_activeclient(c);
+        return c;
+    }
+    return NULL;
+}
+
 struct gate_client*
 sc_gate_firstclient() {
     return G->p;
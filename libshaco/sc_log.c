@@ -4,6 +4,7 @@
 #include "sc_init.h"
 #include "sc_timer.h"
 #include "sc_service.h"
+#include "sc_reactor.h"
 #include "sc_init.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -13,9 +14,50 @@
 #include <time.h>
 #include <execinfo.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+
+/*
+ * the log line is formated in the ring slot by the caller thread,
+ * and the writer thread batch the lines to the log service (see service_log),
+ * so the file write and rollover is off the loop. the ring is a bounded
+ * multi producer single consumer queue, each slot has a sequence
+ */
+
+#define LOG_LINE 1024
+#define LOG_BATCH (64*1024)
+#define LOG_RING_DEF 4096
+
+struct _slot {
+    uint64_t seq;
+    int sz;
+    char data[LOG_LINE];
+};
+
+struct _async {
+    bool run;
+    bool block; // block the caller if full, else drop
+    int cap;
+    struct _slot* slots;
+    uint64_t tail; // producer
+    uint64_t head; // consumer
+    uint64_t dropped;
+    int sleeping;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
 
 static int _LEVEL = LOG_INFO;
+static pthread_mutex_t _LOCK = PTHREAD_MUTEX_INITIALIZER;
 static int _LOG_SERVICE = SERVICE_INVALID;
+static struct _async* A = NULL;
+
+// the prefix till second is cached, the caller thread has its own
+static __thread time_t _STAMP_SEC = -1;
+static __thread int _STAMP_LEN = 0;
+static __thread char _STAMP[64];
 
 static const char* STR_LEVELS[LOG_MAX] = {
     "DEBUG", "INFO", "WARNING", "ERROR", "REC", "EXIT", "PANIC",
@@ -61,17 +103,36 @@ _prefix(int level, char* buf, int sz) {
     uint64_t now = sc_timer_now();
     time_t sec = now / 1000;
     uint32_t msec = now % 1000;
-    int n;
-    n  = snprintf(buf, sz, "[%d ", (int)getpid());
-    n += strftime(buf+n, sz-n, "%y%m%d-%H:%M:%S.", localtime(&sec));
+    if (sec != _STAMP_SEC) {
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        int n = snprintf(_STAMP, sizeof(_STAMP), "[%d ", (int)getpid());
+        n += strftime(_STAMP+n, sizeof(_STAMP)-n, "%y%m%d-%H:%M:%S.", &tm);
+        _STAMP_LEN = n;
+        _STAMP_SEC = sec;
+    }
+    memcpy(buf, _STAMP, _STAMP_LEN);
+    int n = _STAMP_LEN;
     n += snprintf(buf+n, sz-n, "%03d] %s: ", msec, _levelstr(level));
     return n;
 }
 
+// format one line end with '\n' to buf of LOG_LINE
+static int
+_format(int level, char* buf, const char* fmt, va_list ap) {
+    int n = _prefix(level, buf, LOG_LINE);
+    n += vsnprintf(buf+n, LOG_LINE-n, fmt, ap);
+    if (n > LOG_LINE-2)
+        n = LOG_LINE-2; // truncated
+    buf[n++] = '\n';
+    buf[n] = '\0';
+    return n;
+}
+
 static void
 _log(int level, char* log, int sz) {
     if (_LOG_SERVICE < 0) {
-        fprintf(stderr, log);
+        fputs(log, stderr);
         return;
     }
     struct service_message sm;
@@ -79,26 +140,174 @@ _log(int level, char* log, int sz) {
     sm.source = SERVICE_HOST;
     sm.sz = sz;
     sm.msg = log;
-    service_notify_service(_LOG_SERVICE, &sm);
+    if (sc_reactor_multi()) {
+        // log service is shared by all reactor
+        pthread_mutex_lock(&_LOCK);
+        service_notify_service(_LOG_SERVICE, &sm);
+        pthread_mutex_unlock(&_LOCK);
+    } else {
+        service_notify_service(_LOG_SERVICE, &sm);
+    }
+}
+
+static void
+_wakeup(struct _async* a) {
+    if (__atomic_load_n(&a->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_signal(&a->cond);
+        pthread_mutex_unlock(&a->lock);
+    }
+}
+
+// reserve a slot, NULL if full and dropped
+static struct _slot*
+_reserve(struct _async* a) {
+    uint64_t pos = __atomic_load_n(&a->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        struct _slot* slot = &a->slots[pos & (a->cap-1)];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&a->tail, &pos, pos+1, true,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                return slot;
+        } else if (diff < 0) {
+            if (!a->block) {
+                __atomic_add_fetch(&a->dropped, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+            _wakeup(a);
+            sched_yield();
+            pos = __atomic_load_n(&a->tail, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&a->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static inline void
+_commit(struct _async* a, struct _slot* slot) {
+    uint64_t pos = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, pos+1, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    _wakeup(a);
+}
+
+// pop the committed lines to batch, return the size
+static int
+_drain(struct _async* a, char* batch, int sz) {
+    int n = 0;
+    for (;;) {
+        struct _slot* slot = &a->slots[a->head & (a->cap-1)];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != a->head + 1)
+            break;
+        if (n + slot->sz > sz)
+            break;
+        memcpy(batch + n, slot->data, slot->sz);
+        n += slot->sz;
+        __atomic_store_n(&slot->seq, a->head + a->cap, __ATOMIC_RELEASE);
+        __atomic_store_n(&a->head, a->head + 1, __ATOMIC_RELEASE);
+    }
+    return n;
+}
+
+static inline bool
+_empty(struct _async* a) {
+    struct _slot* slot = &a->slots[a->head & (a->cap-1)];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != a->head + 1;
+}
+
+static void*
+_writer(void* ud) {
+    struct _async* a = ud;
+    char* batch = malloc(LOG_BATCH + 1);
+    uint64_t reported = 0;
+    for (;;) {
+        int n = _drain(a, batch, LOG_BATCH);
+        uint64_t dropped = __atomic_load_n(&a->dropped, __ATOMIC_RELAXED);
+        if (dropped != reported && n + LOG_LINE <= LOG_BATCH) {
+            n += snprintf(batch + n, LOG_LINE, "[%d] WARNING: log dropped %llu lines\n",
+                    (int)getpid(), (unsigned long long)(dropped - reported));
+            reported = dropped;
+        }
+        if (n > 0) {
+            batch[n] = '\0';
+            _log(LOG_INFO, batch, n);
+            continue;
+        }
+        if (!__atomic_load_n(&a->run, __ATOMIC_ACQUIRE))
+            break;
+        __atomic_store_n(&a->sleeping, 1, __ATOMIC_SEQ_CST);
+        if (_empty(a)) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100 * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec += 1;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_mutex_lock(&a->lock);
+            if (_empty(a) && __atomic_load_n(&a->run, __ATOMIC_ACQUIRE))
+                pthread_cond_timedwait(&a->cond, &a->lock, &ts);
+            pthread_mutex_unlock(&a->lock);
+        }
+        __atomic_store_n(&a->sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+    free(batch);
+    return NULL;
+}
+
+// wait the writer write all lines, before exit
+static void
+_flush() {
+    struct _async* a = A;
+    if (a == NULL)
+        return;
+    int i;
+    for (i=0; i<1000; ++i) {
+        uint64_t tail = __atomic_load_n(&a->tail, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&a->head, __ATOMIC_ACQUIRE) >= tail)
+            return;
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_signal(&a->cond);
+        pthread_mutex_unlock(&a->lock);
+        usleep(1000);
+    }
 }
 
 static void
 sc_logv(int level, const char* fmt, va_list ap) {
-    char buf[1024] = {0};
-    int n;
-    n = _prefix(level, buf, sizeof(buf));
-    n += vsnprintf(buf+n, sizeof(buf)-n, fmt, ap);
-    n += snprintf(buf+n, sizeof(buf)-n, "\n");
-    _log(level, buf, n);
+    struct _async* a = A;
+    if (a) {
+        struct _slot* slot = _reserve(a);
+        if (slot) {
+            slot->sz = _format(level, slot->data, fmt, ap);
+            _commit(a, slot);
+        }
+    } else {
+        char buf[LOG_LINE];
+        int n = _format(level, buf, fmt, ap);
+        _log(level, buf, n);
+    }
+}
+
+static void
+_logf(int level, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    sc_logv(level, fmt, ap);
+    va_end(ap);
 }
 
 static void
 sc_log(int level, const char* log) {
-    char buf[1024] = {0};
-    int n;
-    n = _prefix(level, buf, sizeof(buf));
-    n += snprintf(buf+n, sizeof(buf)-n, "%s\n", log);
-    _log(level, buf, n);
+    _logf(level, "%s", log);
+}
+
+uint64_t
+sc_log_dropped() {
+    return A ? __atomic_load_n(&A->dropped, __ATOMIC_RELAXED) : 0;
 }
 
 void 
@@ -155,6 +364,7 @@ sc_exit(const char* fmt, ...) {
     va_start(ap, fmt);
     sc_logv(LOG_EXIT, fmt, ap);
     va_end(ap);
+    _flush();
     exit(1);
 }
 
@@ -180,9 +390,56 @@ sc_panic(const char* fmt, ...) {
 
     sc_log(LOG_PANIC, "Panic detected at:");
     sc_log_backtrace();
+    _flush();
     abort();
 }
 
+static int
+_async_start() {
+    int cap = sc_getint("sc_log_ring", LOG_RING_DEF);
+    if (cap <= 0)
+        return 0; // sync
+    int n = 1;
+    while (n < cap)
+        n <<= 1;
+    struct _async* a = malloc(sizeof(*a));
+    memset(a, 0, sizeof(*a));
+    a->run = true;
+    a->block = strcmp(sc_getstr("sc_log_overflow", "drop"), "block") == 0;
+    a->cap = n;
+    a->slots = malloc(sizeof(struct _slot) * n);
+    int i;
+    for (i=0; i<n; ++i) {
+        a->slots[i].seq = i;
+    }
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->cond, NULL);
+    if (pthread_create(&a->thread, NULL, _writer, a)) {
+        free(a->slots);
+        free(a);
+        return 1;
+    }
+    A = a;
+    return 0;
+}
+
+static void
+_async_stop() {
+    struct _async* a = A;
+    if (a == NULL)
+        return;
+    __atomic_store_n(&a->run, false, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&a->lock);
+    pthread_cond_signal(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->thread, NULL);
+    A = NULL;
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->cond);
+    free(a->slots);
+    free(a);
+}
+
 static void
 sc_log_init() {
     const char* level; 
@@ -199,9 +456,20 @@ sc_log_init() {
     sc_log_setlevelstr(level); 
 }
 
+// start the writer after all services prepared, the lines before are
+// write in the caller thread, so no one append with the writer together
+static void
+sc_log_start() {
+    if (_async_start()) {
+        sc_exit("log writer thread create fail");
+    }
+}
+
 static void 
 sc_log_fini() {
+    _async_stop();
     _LOG_SERVICE = SERVICE_INVALID;
 }
 
 SC_LIBRARY_INIT_PRIO(sc_log_init, sc_log_fini, 12)
+SC_LIBRARY_INIT_PRIO(sc_log_start, NULL, 60)
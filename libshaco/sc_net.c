@@ -5,20 +5,72 @@
 #include "sc_log.h"
 #include "sc_service.h"
 #include "sc_dispatcher.h"
+#include "sc_reactor.h"
+#include "sc_profile.h"
 #include "net.h"
 #include <stdlib.h>
+#include <string.h>
 #include <arpa/inet.h>
 #include <signal.h>
 
 #define RDBUFFER_SIZE 64*1024
+#define MULTICAST_BATCH 64
+#define FLUSH_BATCH 16
 
-static struct net* N = NULL;
+// each reactor own a net, connid = reactor * max + id of the net
+struct sc_net {
+    int max;
+    int count;
+    struct net** nets;
+};
+
+static struct sc_net* N = NULL;
+
+static inline int
+_owner(int connid) {
+    return connid >= 0 ? connid / N->max : 0;
+}
+
+static inline struct net*
+_net(int connid) {
+    int r = _owner(connid);
+    return r < N->count ? N->nets[r] : N->nets[0];
+}
+
+static inline int
+_local(int connid) {
+    return connid >= 0 ? connid % N->max : connid;
+}
+
+static inline void
+_global(int reactor, struct net_message* nm) {
+    if (nm->connid >= 0) {
+        nm->connid += reactor * N->max;
+    }
+}
+
+static inline int
+_service_reactor(int serviceid) {
+    int r = service_query_reactor(serviceid);
+    return r == SC_REACTOR_ANY ? sc_reactor_current() : r;
+}
+
+static void
+_wakeup(struct net_message* nm) {
+    char buf[64];
+    int e;
+    while (net_readto(_net(nm->connid), _local(nm->connid), buf, sizeof(buf), &e) > 0);
+}
 
 static void
 _dispatch_one(struct net_message* nm) {
     if (nm->type == NETE_INVALID) {
         return;
     }
+    if (nm->ut == NETUT_WAKEUP) {
+        _wakeup(nm);
+        return;
+    }
     int serviceid = nm->ud;
     if (nm->type == NETE_CONN_THEN_READ) {
         nm->type = NETE_CONNECT;
@@ -39,12 +91,13 @@ _dispatch_one(struct net_message* nm) {
 }
 
 static void
-_dispatch() {
+_dispatch(int reactor) {
     struct net_message* all = NULL;
-    int n = net_getevents(N, &all);
+    int n = net_getevents(N->nets[reactor], &all);
     int i;
     for (i=0; i<n; ++i) {
         struct net_message* nm = &all[i];
+        _global(reactor, nm);
         _dispatch_one(nm);
     }
 }
@@ -52,21 +105,24 @@ _dispatch() {
 int
 sc_net_listen(const char* addr, uint16_t port, int wbuffermax, int serviceid, int ut) {
     uint32_t ip = inet_addr(addr);
-    int err = net_listen(N, ip, port, wbuffermax, serviceid, ut);
+    int r = _service_reactor(serviceid);
+    int err = net_listen(N->nets[r], ip, port, wbuffermax, serviceid, ut);
     if (err) {
-        sc_error("listen %s:%u fail: %s", addr, port, sc_net_error(err)); 
+        sc_error("listen %s:%u fail: %s", addr, port, sc_net_error(err));
     } else {
         sc_info("listen on %s:%d", addr, port);
     }
     return err;
 }
 
-int 
-sc_net_connect(const char* addr, uint16_t port, bool block, int serviceid, int ut) { 
+int
+sc_net_connect(const char* addr, uint16_t port, bool block, int serviceid, int ut) {
     uint32_t ip = inet_addr(addr);
     struct net_message nm;
-    int n = net_connect(N, ip, port, block, 0, serviceid, ut, &nm);
+    int r = _service_reactor(serviceid);
+    int n = net_connect(N->nets[r], ip, port, block, 0, serviceid, ut, &nm);
     if (n > 0) {
+        _global(r, &nm);
         _dispatch_one(&nm);
         return nm.type == NETE_CONNERR;
     }
@@ -75,68 +131,222 @@ sc_net_connect(const char* addr, uint16_t port, bool block, int serviceid, int u
 
 void
 sc_net_poll(int timeout) {
-    int n = net_poll(N, timeout);
+    int r = sc_reactor_current();
+    uint64_t t = sc_profile_begin();
+    int n = net_poll(N->nets[r], timeout);
+    t = sc_profile_phase(PROF_WAIT, t);
     if (n > 0) {
-        _dispatch();
+        _dispatch(r);
     }
+    sc_profile_phase(PROF_NET, t);
 }
 
-int 
+// write the corked sockets once before the next poll
+void
+sc_net_flush() {
+    int r = sc_reactor_current();
+    struct net_message nm[FLUSH_BATCH];
+    int c, i;
+    do {
+        c = net_flush(N->nets[r], nm, FLUSH_BATCH);
+        for (i=0; i<c; ++i) {
+            _global(r, &nm[i]);
+            _dispatch_one(&nm[i]);
+        }
+    } while (c == FLUSH_BATCH);
+}
+
+int
 sc_net_send(int id, void* data, int sz) {
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = sz > 0 ? sz : 0;
+    return sc_net_sendv(id, &iov, 1);
+}
+
+int
+sc_net_sendv(int id, const struct iovec* iov, int cnt) {
+    int r = _owner(id);
+    if (r != sc_reactor_current()) {
+        if (r < N->count) {
+            return sc_reactor_post_sendv(r, id, iov, cnt);
+        }
+        return -1;
+    }
     struct net_message nm;
-    int n = net_send(N, id, data, sz, &nm);
+    int n = net_sendv(N->nets[r], _local(id), iov, cnt, &nm);
     if (n > 0) {
+        _global(r, &nm);
         _dispatch_one(&nm);
     }
     return n;
 }
 
-int 
+static void
+_multicast(int reactor, const int* ids, int n, void* data, int sz) {
+    struct net_message nm[MULTICAST_BATCH];
+    int c = net_multicast(N->nets[reactor], ids, n, data, sz, nm);
+    int i;
+    for (i=0; i<c; ++i) {
+        _global(reactor, &nm[i]);
+        _dispatch_one(&nm[i]);
+    }
+}
+
+int
+sc_net_multicast(const int* ids, int n, void* data, int sz) {
+    if (sz <= 0) {
+        return -1;
+    }
+    int r = sc_reactor_current();
+    int local[MULTICAST_BATCH];
+    int nlocal = 0;
+    int i;
+    for (i=0; i<n; ++i) {
+        if (_owner(ids[i]) != r) {
+            sc_net_send(ids[i], data, sz);
+            continue;
+        }
+        local[nlocal++] = _local(ids[i]);
+        if (nlocal == MULTICAST_BATCH) {
+            _multicast(r, local, nlocal, data, sz);
+            nlocal = 0;
+        }
+    }
+    if (nlocal > 0) {
+        _multicast(r, local, nlocal, data, sz);
+    }
+    return 0;
+}
+
+int
 sc_net_readto(int id, void* buf, int space, int* e) {
-    return net_readto(N, id, buf, space, e); 
+    return net_readto(_net(id), _local(id), buf, space, e);
 }
 
 int
-sc_net_read(int id, bool force, struct mread_buffer* buf, int* e) { 
-    return net_read(N, id, force, buf, e); 
+sc_net_read(int id, bool force, struct mread_buffer* buf, int* e) {
+    return net_read(_net(id), _local(id), force, buf, e);
 }
 
-void sc_net_dropread(int id, int sz) { 
-    net_dropread(N, id, sz); 
+void sc_net_dropread(int id, int sz) {
+    net_dropread(_net(id), _local(id), sz);
+}
+bool sc_net_close_socket(int id, bool force) {
+    return net_close_socket(_net(id), _local(id), force);
+}
+const char* sc_net_error(int err) {
+    return net_error(N->nets[0], err);
+}
+int sc_net_max_socket() {
+    return N->max * N->count;
+}
+// the other reactor is read without lock, it is only for stat
+int64_t sc_net_sendbytes() {
+    int64_t bytes = 0;
+    int i;
+    for (i=0; i<N->count; ++i) {
+        bytes += net_sendbytes(N->nets[i]);
+    }
+    return bytes;
+}
+int64_t sc_net_readbytes(int64_t* cached) {
+    int64_t bytes = 0;
+    int64_t all = 0;
+    int i;
+    for (i=0; i<N->count; ++i) {
+        int64_t n = 0;
+        bytes += net_readbytes(N->nets[i], &n);
+        all += n;
+    }
+    if (cached)
+        *cached = all;
+    return bytes;
 }
-bool sc_net_close_socket(int id, bool force) { 
-    return net_close_socket(N, id, force); 
+// return the message queued by the cork sockets, and the write of them
+int64_t sc_net_corkstat(int64_t* writes) {
+    int64_t msgs = 0;
+    int64_t all = 0;
+    int i;
+    for (i=0; i<N->count; ++i) {
+        int64_t m = 0, w = 0;
+        net_corkstat(N->nets[i], &m, &w);
+        msgs += m;
+        all += w;
+    }
+    if (writes)
+        *writes = all;
+    return msgs;
 }
-const char* sc_net_error(int err) { 
-    return net_error(N, err); 
+int sc_net_subscribe(int id, bool read) {
+    return net_subscribe(_net(id), _local(id), read);
 }
-int sc_net_max_socket() { 
-    return net_max_socket(N); 
+void sc_net_requeue(int id) {
+    net_requeue(_net(id), _local(id));
 }
-int sc_net_subscribe(int id, bool read) { 
-    return net_subscribe(N, id, read); 
+int64_t sc_net_requeuestat() {
+    int64_t n = 0;
+    int i;
+    for (i=0; i<N->count; ++i) {
+        n += net_requeuestat(N->nets[i]);
+    }
+    return n;
 }
-int sc_net_socket_address(int id, uint32_t* addr, uint16_t* port) { 
-    return net_socket_address(N, id, addr, port); 
+int sc_net_socket_address(int id, uint32_t* addr, uint16_t* port) {
+    return net_socket_address(_net(id), _local(id), addr, port);
 }
 int sc_net_socket_isclosed(int id) {
-    return net_socket_isclosed(N, id);
+    return net_socket_isclosed(_net(id), _local(id));
 }
 
 static void
 sc_net_init() {
     int max = sc_getint("sc_connmax", 0);
+    // bit of the socket ut, default the trust node link
+    int corkmask = sc_getint("sc_net_cork", 1 << NETUT_TRUST);
+    int corkmax = sc_getint("sc_net_corkmax", 64*1024);
+    int poller = NET_POLLER_EPOLL;
+    // epoll edge trigger, accept and read until EAGAIN
+    if (sc_getint("sc_net_edge", 0)) {
+        poller |= NET_POLLER_EDGE;
+    }
     signal(SIGHUP, SIG_IGN);
     signal(SIGPIPE, SIG_IGN);
-    N = net_create(max, RDBUFFER_SIZE);
-    if (N == NULL) {
-        sc_exit("net_create fail, max=%d", max);
+    N = malloc(sizeof(*N));
+    N->max = max;
+    N->count = sc_reactor_count();
+    N->nets = malloc(sizeof(struct net*) * N->count);
+    int i;
+    for (i=0; i<N->count; ++i) {
+        N->nets[i] = net_create(max, RDBUFFER_SIZE, poller);
+        if (N->nets[i] == NULL) {
+            sc_exit("net_create fail, max=%d", max);
+        }
+        if (i == 0) {
+            if (net_poller(N->nets[i]) != poller) {
+                sc_warning("net edge trigger is epoll only, ignore it");
+            }
+        }
+        net_cork(N->nets[i], (uint32_t)corkmask, corkmax);
+        if (sc_reactor_multi()) {
+            if (net_attach(N->nets[i], sc_reactor_wakeupfd(i),
+                        SERVICE_INVALID, NETUT_WAKEUP)) {
+                sc_exit("net_attach wakeup fail, reactor=%d", i);
+            }
+        }
     }
 }
 
 static void
 sc_net_fini() {
-    net_free(N);
+    if (N == NULL)
+        return;
+    int i;
+    for (i=0; i<N->count; ++i) {
+        net_free(N->nets[i]);
+    }
+    free(N->nets);
+    free(N);
     N = NULL;
 }
 
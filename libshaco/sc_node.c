@@ -1,6 +1,7 @@
 #include "sc_node.h"
 #include "sc_init.h"
 #include "sc_log.h"
+#include "sc_env.h"
 #include "sc_net.h"
 #include <limits.h>
 #include <stdint.h>
@@ -22,8 +23,17 @@ struct _array {
     struct sc_node* p;
 };
 
+// weight of the load report
+struct _weight {
+    int room;
+    int client;
+    int tick;  // per millisecond of tick_p99
+    int sendq; // per KB of sendbytes
+};
+
 struct _node_holder {
     uint16_t me; 
+    struct _weight weight;
     int size;
     struct _type* types;
     struct _array* nodes;
@@ -101,6 +111,7 @@ _init_node(struct sc_node* node) {
     node->gport = 0;
     node->connid = -1;
     node->load = 0;
+    memset(&node->report, 0, sizeof(node->report));
 }
 
 static inline void
@@ -136,6 +147,7 @@ _add_node(struct _array* arr, struct sc_node* node) {
     if (_isfree_node(c)) {
         *c = *node;
         c->load = 0;
+        memset(&c->report, 0, sizeof(c->report));
         arr->size = idx + 1;
         return 0;
     }
@@ -340,6 +352,8 @@ sc_node_updateload(uint16_t id, int value) {
     struct sc_node* node = _get_node(id);
     if (node) {
         node->load += value;
+        if (node->load < 0)
+            node->load = 0;
     }
 }
 
@@ -351,10 +365,32 @@ sc_node_setload(uint16_t id, int value) {
     }
 }
 
+void
+sc_node_report(uint16_t id, const struct sc_node_loadreport* report) {
+    struct sc_node* node = _get_node(id);
+    if (node) {
+        const struct _weight* w = &N->weight;
+        node->report = *report;
+        node->load = report->rooms * w->room +
+                     report->clients * w->client +
+                     report->tick_p99 / 1000 * w->tick +
+                     report->sendbytes / 1024 * w->sendq;
+    }
+}
+
+int
+sc_node_roomload() {
+    return N->weight.room;
+}
+
 static void
 sc_node_init() {
     N = malloc(sizeof(*N));
     memset(N, 0, sizeof(*N));
+    N->weight.room = sc_getint("node_weight_room", 10);
+    N->weight.client = sc_getint("node_weight_client", 1);
+    N->weight.tick = sc_getint("node_weight_tick", 20);
+    N->weight.sendq = sc_getint("node_weight_sendq", 1);
     //N->me = -1;
 }
 
@@ -0,0 +1,235 @@
+#include "sc_profile.h"
+#include "sc_init.h"
+#include "sc_env.h"
+#include "sc_service.h"
+#include "sc_reactor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <time.h>
+
+/*
+ * the loop phases of each reactor and the service callbacks,
+ * keep the last WINDOW samples (microseconds) for p50/p99/max.
+ * each reactor write its own, the service may be written by
+ * several reactors if not pinned, the stat is approximate then
+ */
+
+#define WINDOW 256
+
+struct window {
+    uint64_t n;
+    uint32_t v[WINDOW];
+};
+
+struct reactor_prof {
+    uint64_t loops;
+    uint64_t loops_mark;
+    uint64_t loops_rate; // of last second
+    uint64_t second;
+    uint64_t acc[PROF_PHASE_MAX];
+    uint64_t last[PROF_PHASE_MAX]; // of last second
+    struct window phase[PROF_PHASE_MAX];
+};
+
+struct service_prof {
+    int interval;
+    struct window call[PROF_CALL_MAX];
+    struct window lag; // milliseconds
+};
+
+struct sc_profile {
+    bool enable;
+    int nreactor;
+    int nservice;
+    struct reactor_prof* rp;
+    struct service_prof* sp;
+};
+
+static struct sc_profile* P = NULL;
+
+static const char* STR_PHASE[PROF_PHASE_MAX] = {
+    "wait", "net", "mail", "timer", "defer", "flush",
+};
+
+static const char* STR_CALL[PROF_CALL_MAX] = {
+    "time", "net", "nodemsg", "usermsg",
+};
+
+static inline uint64_t
+_now() {
+    struct timespec ti;
+    clock_gettime(CLOCK_MONOTONIC, &ti);
+    return (uint64_t)ti.tv_sec * 1000000 + ti.tv_nsec / 1000;
+}
+
+static inline void
+_push(struct window* w, uint64_t v) {
+    w->v[w->n & (WINDOW-1)] = v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+    w->n++;
+}
+
+uint64_t
+sc_profile_begin() {
+    if (P == NULL || !P->enable)
+        return 0;
+    return _now();
+}
+
+void
+sc_profile_loop() {
+    if (P == NULL || !P->enable)
+        return;
+    struct reactor_prof* rp = &P->rp[sc_reactor_current()];
+    rp->loops++;
+    uint64_t second = _now() / 1000000;
+    if (second != rp->second) {
+        rp->loops_rate = rp->loops - rp->loops_mark;
+        rp->loops_mark = rp->loops;
+        if (second != rp->second + 1) {
+            rp->loops_rate = 0; // idle more than one second
+        }
+        rp->second = second;
+        memcpy(rp->last, rp->acc, sizeof(rp->acc));
+        memset(rp->acc, 0, sizeof(rp->acc));
+    }
+}
+
+uint64_t
+sc_profile_phase(int phase, uint64_t begin) {
+    if (begin == 0)
+        return 0;
+    uint64_t now = _now();
+    uint64_t us = now - begin;
+    struct reactor_prof* rp = &P->rp[sc_reactor_current()];
+    rp->acc[phase] += us;
+    _push(&rp->phase[phase], us);
+    return now;
+}
+
+void
+sc_profile_service(int serviceid, int call, uint64_t begin) {
+    if (begin == 0 || serviceid < 0 || serviceid >= P->nservice)
+        return;
+    _push(&P->sp[serviceid].call[call], _now() - begin);
+}
+
+void
+sc_profile_lag(int serviceid, int interval, int lag) {
+    if (P == NULL || !P->enable || serviceid < 0 || serviceid >= P->nservice)
+        return;
+    struct service_prof* sp = &P->sp[serviceid];
+    sp->interval = interval;
+    _push(&sp->lag, lag > 0 ? lag : 0);
+}
+
+static int
+_cmp(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// p50, p99, max of the window, return the sample count
+static int
+_percentile(const struct window* w, uint32_t* p50, uint32_t* p99, uint32_t* max) {
+    int n = w->n < WINDOW ? (int)w->n : WINDOW;
+    if (n == 0)
+        return 0;
+    uint32_t tmp[WINDOW];
+    memcpy(tmp, w->v, sizeof(uint32_t) * n);
+    qsort(tmp, n, sizeof(uint32_t), _cmp);
+    *p50 = tmp[n/2];
+    *p99 = tmp[(n*99)/100];
+    *max = tmp[n-1];
+    return n;
+}
+
+#define APPEND(...) do { \
+    if (len < sz) { \
+        int n = snprintf(buf + len, sz - len, __VA_ARGS__); \
+        if (n > 0) len += n; \
+        if (len >= sz) len = sz - 1; \
+    } \
+} while (0)
+
+int
+sc_profile_dump(char* buf, int sz) {
+    int len = 0;
+    if (P == NULL || !P->enable) {
+        APPEND("profile off");
+        return len;
+    }
+    uint32_t p50, p99, max;
+    int i, c;
+    for (i=0; i<P->nreactor; ++i) {
+        struct reactor_prof* rp = &P->rp[i];
+        APPEND("reactor %d: loops %llu/s", i, (unsigned long long)rp->loops_rate);
+        for (c=0; c<PROF_PHASE_MAX; ++c) {
+            APPEND(", %s %.1f%%", STR_PHASE[c], rp->last[c] / 10000.0);
+        }
+        APPEND("\n");
+        for (c=0; c<PROF_PHASE_MAX; ++c) {
+            if (_percentile(&rp->phase[c], &p50, &p99, &max)) {
+                APPEND("  %s p50 %uus, p99 %uus, max %uus\n", STR_PHASE[c], p50, p99, max);
+            }
+        }
+    }
+    for (i=0; i<P->nservice; ++i) {
+        struct service_prof* sp = &P->sp[i];
+        bool title = false;
+        for (c=0; c<PROF_CALL_MAX; ++c) {
+            if (_percentile(&sp->call[c], &p50, &p99, &max)) {
+                if (!title) {
+                    title = true;
+                    APPEND("service %s:\n", service_query_name(i));
+                }
+                APPEND("  %s count %llu, p50 %uus, p99 %uus, max %uus\n", STR_CALL[c],
+                        (unsigned long long)sp->call[c].n, p50, p99, max);
+            }
+        }
+        if (_percentile(&sp->lag, &p50, &p99, &max)) {
+            APPEND("  tick %dms, lag p50 %ums, p99 %ums, max %ums\n",
+                    sp->interval, p50, p99, max);
+        }
+    }
+    return len;
+}
+
+void
+sc_profile_reset() {
+    if (P == NULL)
+        return;
+    memset(P->rp, 0, sizeof(struct reactor_prof) * P->nreactor);
+    int i;
+    for (i=0; i<P->nservice; ++i) {
+        int interval = P->sp[i].interval;
+        memset(&P->sp[i], 0, sizeof(struct service_prof));
+        P->sp[i].interval = interval;
+    }
+}
+
+static void
+sc_profile_init() {
+    P = malloc(sizeof(*P));
+    P->enable = sc_getint("sc_profile", 1);
+    P->nreactor = sc_reactor_count();
+    P->nservice = service_count();
+    P->rp = malloc(sizeof(struct reactor_prof) * P->nreactor);
+    memset(P->rp, 0, sizeof(struct reactor_prof) * P->nreactor);
+    P->sp = malloc(sizeof(struct service_prof) * (P->nservice > 0 ? P->nservice : 1));
+    memset(P->sp, 0, sizeof(struct service_prof) * (P->nservice > 0 ? P->nservice : 1));
+}
+
+static void
+sc_profile_fini() {
+    if (P == NULL)
+        return;
+    free(P->rp);
+    free(P->sp);
+    free(P);
+    P = NULL;
+}
+
+SC_LIBRARY_INIT_PRIO(sc_profile_init, sc_profile_fini, 13)
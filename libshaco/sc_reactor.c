@@ -0,0 +1,284 @@
+#include "sc_reactor.h"
+#include "sc.h"
+#include "sc_init.h"
+#include "sc_env.h"
+#include "sc_net.h"
+#include "sc_service.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/*
+ * multi reactor, each reactor own a net, a timer and a mailbox,
+ * reactor 0 run in main thread, the others run in their own thread (see sc_start).
+ * the mailbox is a lock-free multi producer single consumer queue,
+ * the pipe just for wakeup the poll of consumer.
+ */
+
+#define REACTOR_MAX 64
+
+#define MAIL_NODEMSG 0
+#define MAIL_SEND    1
+
+struct mail {
+    struct mail* next;
+    int type;
+    int serviceid;
+    int id;
+    int sz;
+    char data[0];
+};
+
+struct mailbox {
+    struct mail* head; // producer push here
+    struct mail* tail; // consumer pop here
+    struct mail stub;
+    int signaled;
+    int pipefd[2];
+};
+
+struct defer {
+    void (*cb)(void* ud);
+    void* ud;
+};
+
+struct deferlist {
+    int sz;
+    int cap;
+    struct defer* p;
+};
+
+struct reactor_holder {
+    int count;
+    struct mailbox* boxes;
+    struct deferlist* defers;
+};
+
+static struct reactor_holder* R = NULL;
+static __thread int _CURRENT = 0;
+
+int
+sc_reactor_count() {
+    return R->count;
+}
+
+int
+sc_reactor_current() {
+    return _CURRENT;
+}
+
+void
+sc_reactor_enter(int reactor) {
+    _CURRENT = reactor;
+}
+
+bool
+sc_reactor_multi() {
+    return R->count > 1;
+}
+
+int
+sc_reactor_wakeupfd(int reactor) {
+    return R->boxes[reactor].pipefd[0];
+}
+
+void
+sc_reactor_wakeup(int reactor) {
+    struct mailbox* mb = &R->boxes[reactor];
+    if (__atomic_exchange_n(&mb->signaled, 1, __ATOMIC_ACQ_REL) == 0) {
+        char c = 0;
+        write(mb->pipefd[1], &c, 1);
+    }
+}
+
+static void
+_mailbox_init(struct mailbox* mb) {
+    memset(mb, 0, sizeof(*mb));
+    mb->head = &mb->stub;
+    mb->tail = &mb->stub;
+    mb->pipefd[0] = -1;
+    mb->pipefd[1] = -1;
+}
+
+static void
+_mailbox_push(struct mailbox* mb, struct mail* m) {
+    m->next = NULL;
+    struct mail* prev = __atomic_exchange_n(&mb->head, m, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, m, __ATOMIC_RELEASE);
+}
+
+static struct mail*
+_mailbox_pop(struct mailbox* mb) {
+    struct mail* tail = mb->tail;
+    struct mail* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (tail == &mb->stub) {
+        if (next == NULL)
+            return NULL;
+        mb->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        mb->tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&mb->head, __ATOMIC_ACQUIRE))
+        return NULL; // producer in progress, next dispatch will get it
+    _mailbox_push(mb, &mb->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        mb->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static void
+_post(int reactor, int type, int serviceid, int id, const struct iovec* iov, int cnt, int sz) {
+    struct mail* m = malloc(sizeof(*m) + sz);
+    m->type = type;
+    m->serviceid = serviceid;
+    m->id = id;
+    m->sz = sz;
+    char* p = m->data;
+    int i;
+    for (i=0; i<cnt; ++i) {
+        memcpy(p, iov[i].iov_base, iov[i].iov_len);
+        p += iov[i].iov_len;
+    }
+    _mailbox_push(&R->boxes[reactor], m);
+    sc_reactor_wakeup(reactor);
+}
+
+void
+sc_reactor_post_nodemsg(int reactor, int serviceid, int id, void* msg, int sz) {
+    struct iovec iov;
+    iov.iov_base = msg;
+    iov.iov_len = sz;
+    _post(reactor, MAIL_NODEMSG, serviceid, id, &iov, 1, sz);
+}
+
+int
+sc_reactor_post_sendv(int reactor, int connid, const struct iovec* iov, int cnt) {
+    int sz = 0;
+    int i;
+    for (i=0; i<cnt; ++i) {
+        sz += iov[i].iov_len;
+    }
+    if (sz <= 0)
+        return -1;
+    _post(reactor, MAIL_SEND, SERVICE_INVALID, connid, iov, cnt, sz);
+    return 0;
+}
+
+void
+sc_reactor_dispatch() {
+    if (R->count <= 1)
+        return;
+    struct mailbox* mb = &R->boxes[_CURRENT];
+    __atomic_store_n(&mb->signaled, 0, __ATOMIC_RELEASE);
+    struct mail* m;
+    while ((m = _mailbox_pop(mb))) {
+        switch (m->type) {
+        case MAIL_NODEMSG:
+            service_notify_nodemsg(m->serviceid, m->id, m->data, m->sz);
+            break;
+        case MAIL_SEND:
+            sc_net_send(m->id, m->data, m->sz);
+            break;
+        }
+        free(m);
+    }
+}
+
+void
+sc_reactor_defer(void (*cb)(void* ud), void* ud) {
+    struct deferlist* dl = &R->defers[_CURRENT];
+    if (dl->sz >= dl->cap) {
+        dl->cap = dl->cap ? dl->cap * 2 : 8;
+        dl->p = realloc(dl->p, sizeof(struct defer) * dl->cap);
+    }
+    dl->p[dl->sz].cb = cb;
+    dl->p[dl->sz].ud = ud;
+    dl->sz++;
+}
+
+static void
+_nodefer(void* ud) {
+}
+
+void
+sc_reactor_undefer(void (*cb)(void* ud), void* ud) {
+    struct deferlist* dl = &R->defers[_CURRENT];
+    int i;
+    for (i=0; i<dl->sz; ++i) {
+        if (dl->p[i].cb == cb && dl->p[i].ud == ud) {
+            dl->p[i].cb = _nodefer;
+        }
+    }
+}
+
+void
+sc_reactor_dispatch_defer() {
+    struct deferlist* dl = &R->defers[_CURRENT];
+    // cb may defer again, it will be call in this loop too
+    int i;
+    for (i=0; i<dl->sz; ++i) {
+        struct defer d = dl->p[i];
+        d.cb(d.ud);
+    }
+    dl->sz = 0;
+}
+
+static void
+sc_reactor_init() {
+    R = malloc(sizeof(*R));
+    int count = sc_getint("sc_reactor", 1);
+    if (count < 1)
+        count = 1;
+    if (count > REACTOR_MAX)
+        count = REACTOR_MAX;
+    R->count = count;
+    R->boxes = malloc(sizeof(struct mailbox) * count);
+    R->defers = malloc(sizeof(struct deferlist) * count);
+    memset(R->defers, 0, sizeof(struct deferlist) * count);
+    int i;
+    for (i=0; i<count; ++i) {
+        struct mailbox* mb = &R->boxes[i];
+        _mailbox_init(mb);
+        if (count > 1) {
+            if (pipe(mb->pipefd) == 0) {
+                fcntl(mb->pipefd[0], F_SETFL, fcntl(mb->pipefd[0], F_GETFL, 0) | O_NONBLOCK);
+                fcntl(mb->pipefd[1], F_SETFL, fcntl(mb->pipefd[1], F_GETFL, 0) | O_NONBLOCK);
+            }
+        }
+    }
+    _CURRENT = 0;
+}
+
+static void
+sc_reactor_fini() {
+    if (R == NULL)
+        return;
+    int i;
+    for (i=0; i<R->count; ++i) {
+        struct mailbox* mb = &R->boxes[i];
+        struct mail* m;
+        while ((m = _mailbox_pop(mb))) {
+            free(m);
+        }
+        // pipefd[0] is attach to net, closed by it
+        if (mb->pipefd[1] != -1)
+            close(mb->pipefd[1]);
+    }
+    for (i=0; i<R->count; ++i) {
+        free(R->defers[i].p);
+    }
+    free(R->defers);
+    free(R->boxes);
+    free(R);
+    R = NULL;
+}
+
+SC_LIBRARY_INIT_PRIO(sc_reactor_init, sc_reactor_fini, 5)
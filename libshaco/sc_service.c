@@ -3,6 +3,9 @@
 #include "sc_init.h"
 #include "sc_env.h"
 #include "sc_log.h"
+#include "sc_reactor.h"
+#include "sc_profile.h"
+#include "sc_net.h"
 #include "array.h"
 #include <stdlib.h>
 #include <dlfcn.h>
@@ -172,6 +175,26 @@ service_query_name(int serviceid) {
     return "";
 }
 
+int
+service_count() {
+    return array_size(S->sers);
+}
+
+int
+service_query_reactor(int serviceid) {
+    struct service* s = array_get(S->sers, serviceid);
+    if (s) {
+        return s->reactor;
+    }
+    return SC_REACTOR_ANY;
+}
+
+static inline bool
+_isremote(struct service* s) {
+    return s->reactor != SC_REACTOR_ANY &&
+           s->reactor != sc_reactor_current();
+}
+
 int 
 service_notify_service(int serviceid, struct service_message* sm) {
     struct service* s = array_get(S->sers, serviceid);
@@ -186,7 +209,9 @@ int
 service_notify_net(int serviceid, struct net_message* nm) {
     struct service* s = array_get(S->sers, serviceid);
     if (s && s->dl.net) {
+        uint64_t t = sc_profile_begin();
         s->dl.net(s, nm);
+        sc_profile_service(serviceid, PROF_SNET, t);
         return 0;
     }
     return 1;
@@ -196,7 +221,9 @@ int
 service_notify_time(int serviceid) {
     struct service* s = array_get(S->sers, serviceid);
     if (s && s->dl.time) {
+        uint64_t t = sc_profile_begin();
         s->dl.time(s);
+        sc_profile_service(serviceid, PROF_TIME, t);
         return 0;
     }
     return 1;
@@ -206,7 +233,13 @@ int
 service_notify_nodemsg(int serviceid, int id, void* msg, int sz) {
     struct service* s = array_get(S->sers, serviceid);
     if (s && s->dl.nodemsg) {
+        if (_isremote(s)) {
+            sc_reactor_post_nodemsg(s->reactor, serviceid, id, msg, sz);
+            return 0;
+        }
+        uint64_t t = sc_profile_begin();
         s->dl.nodemsg(s, id, msg, sz);
+        sc_profile_service(serviceid, PROF_NODEMSG, t);
         return 0;
     }
     return 1;
@@ -216,12 +249,43 @@ int
 service_notify_usermsg(int serviceid, int id, void* msg, int sz) {
     struct service* s = array_get(S->sers, serviceid);
     if (s && s->dl.usermsg) {
+        uint64_t t = sc_profile_begin();
         s->dl.usermsg(s, id, msg, sz);
+        sc_profile_service(serviceid, PROF_USERMSG, t);
         return 0;
     }
     return 1;
 }
 
+// format: "name:reactor,name:reactor", not in list is pinned to reactor 0
+static int
+_affinity(const char* affinity) {
+    size_t len = strlen(affinity);
+    char tmp[len+1];
+    strcpy(tmp, affinity);
+
+    char* saveptr = NULL;
+    char* one = strtok_r(tmp, ",", &saveptr);
+    while (one) {
+        char* sep = strchr(one, ':');
+        if (sep == NULL) {
+            return 1;
+        }
+        *sep = '\0';
+        int reactor = strtol(sep+1, NULL, 10);
+        if (reactor < SC_REACTOR_ANY || reactor >= sc_reactor_count()) {
+            return 1;
+        }
+        struct service* s = _find(one);
+        if (s == NULL) {
+            return 1;
+        }
+        s->reactor = reactor;
+        one = strtok_r(NULL, ",", &saveptr);
+    }
+    return 0;
+}
+
 static void
 service_init() {
     S = malloc(sizeof(*S));
@@ -232,6 +296,11 @@ service_init() {
         service_load(services)) {
         sc_exit("service_load fail, services=%s", services);
     }
+    const char* affinity = sc_getstr("sc_reactor_affinity", "");
+    if (affinity[0] &&
+        _affinity(affinity)) {
+        sc_exit("service affinity fail, affinity=%s", affinity);
+    }
 }
 
 static void
@@ -259,6 +328,23 @@ service_prepareall() {
     }
 }
 
+// free the services in load order before the net and node fini,
+// so they can still send the last messages in free
+static void
+service_freeall() {
+    if (S == NULL || S->sers == NULL)
+        return;
+    int i;
+    for (i=0; i<array_size(S->sers); ++i) {
+        struct service* s = array_get(S->sers, i);
+        if (s && s->dl.free && s->dl.content) {
+            s->dl.free(s->dl.content);
+            s->dl.content = NULL;
+        }
+    }
+    sc_net_flush();
+}
+
 int 
 sc_handler(const char* name, int* handler) {
     *handler = service_query_id(name);
@@ -270,4 +356,4 @@ sc_handler(const char* name, int* handler) {
 }
 
 SC_LIBRARY_INIT_PRIO(service_init, service_fini, 11)
-SC_LIBRARY_INIT_PRIO(service_prepareall, NULL, 50)
+SC_LIBRARY_INIT_PRIO(service_prepareall, service_freeall, 50)
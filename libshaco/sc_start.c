@@ -3,20 +3,65 @@
 #include "sc_timer.h"
 #include "sc_net.h"
 #include "sc_reload.h"
+#include "sc_reactor.h"
+#include "sc_profile.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
 
-static bool RUN = false;
+static volatile bool RUN = false;
 
-void
-sc_start() {
-    sc_info("Shaco start");
+static void
+_loop(int reactor) {
     int timeout;
-    RUN = true;
+    uint64_t t;
+    sc_reactor_enter(reactor);
     while (RUN) {
+        sc_profile_loop();
+        t = sc_profile_begin();
+        sc_net_flush();
+        sc_profile_phase(PROF_FLUSH, t);
         timeout = sc_timer_max_timeout();
         sc_net_poll(timeout);
+        t = sc_profile_begin();
+        sc_reactor_dispatch();
+        t = sc_profile_phase(PROF_MAIL, t);
         sc_timer_dispatch_timeout();
-        sc_reload_execute();
+        t = sc_profile_phase(PROF_TIMER, t);
+        sc_reactor_dispatch_defer();
+        sc_profile_phase(PROF_DEFER, t);
+        if (reactor == 0) {
+            sc_reload_execute();
+        }
+    }
+}
+
+static void*
+_thread(void* ud) {
+    int reactor = (int)(intptr_t)ud;
+    _loop(reactor);
+    return NULL;
+}
+
+void
+sc_start() {
+    sc_info("Shaco start");
+    RUN = true;
+    int n = sc_reactor_count();
+    pthread_t threads[n];
+    int i;
+    for (i=1; i<n; ++i) {
+        if (pthread_create(&threads[i], NULL, _thread, (void*)(intptr_t)i)) {
+            sc_exit("reactor %d thread create fail", i);
+        }
+    }
+    if (n > 1) {
+        sc_info("Shaco %d reactor", n);
+    }
+    _loop(0);
+    for (i=1; i<n; ++i) {
+        pthread_join(threads[i], NULL);
     }
     sc_info("Shaco stop");
 }
@@ -24,4 +69,10 @@ sc_start() {
 void
 sc_stop() {
     RUN = false;
+    if (sc_reactor_multi()) {
+        int i;
+        for (i=0; i<sc_reactor_count(); ++i) {
+            sc_reactor_wakeup(i);
+        }
+    }
 }
@@ -1,37 +1,83 @@
 #include "sc_timer.h"
 #include "sc_init.h"
 #include "sc_service.h"
+#include "sc_reactor.h"
+#include "sc_profile.h"
 #include <time.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <unistd.h>
 
+/*
+ * hierarchical timing wheel, tick is 1 millisecond,
+ * near wheel hold the events expire in 256 ticks,
+ * then 4 levels of 64 slots cascade to the near wheel.
+ * event is linked by index in the pool, so add and del is O(1)
+ */
+
 #define INIT_EVENTS 1
 
+#define NEAR_SHIFT  8
+#define NEAR        (1 << NEAR_SHIFT)
+#define NEAR_MASK   (NEAR - 1)
+#define LEVEL_SHIFT 6
+#define LEVEL       (1 << LEVEL_SHIFT)
+#define LEVEL_MASK  (LEVEL - 1)
+#define LEVEL_MAX   4
+
+// list index in heads
+#define LIST_NEAR(i)     (i)
+#define LIST_LEVEL(l, i) (NEAR + (l) * LEVEL + (i))
+#define LIST_PENDING     (NEAR + LEVEL_MAX * LEVEL)
+#define LIST_MAX         (LIST_PENDING + 1)
+#define LIST_NONE        -1
+
+// id = ((index+1) << 32) | version, 32bit version not wrap in practice
+#define ID_ENCODE(idx, ver) ((((int64_t)(idx)+1) << 32) | (uint32_t)(ver))
+#define ID_INDEX(id) ((int)((id) >> 32) - 1)
+#define ID_VERSION(id) ((uint32_t)(id))
+
 struct _event {
-    int serviceid;
+    int prev;
+    int next;
+    int list; // see LIST_*, LIST_NONE if free
+    uint32_t version;
+    uint32_t expire;
     int interval;
-    uint64_t next_time;
+    void (*cb)(void* ud);
+    void* ud;
 };
 
 struct _event_holder {
     struct _event* p;
-    int sz;
     int cap;
+    int free;
+    int used;
 };
 
 static void
 _event_holder_init(struct _event_holder* eh) {
     eh->cap = INIT_EVENTS;
-    eh->sz = 0;
+    eh->used = 0;
     eh->p = malloc(sizeof(struct _event) * INIT_EVENTS);
+    memset(eh->p, 0, sizeof(struct _event) * INIT_EVENTS);
+    int i;
+    for (i=0; i<eh->cap; ++i) {
+        eh->p[i].next = i+1;
+        eh->p[i].list = LIST_NONE;
+    }
+    eh->p[eh->cap-1].next = -1;
+    eh->free = 0;
 }
 
 static void
 _event_holder_fini(struct _event_holder* eh) {
     free(eh->p);
-    eh->sz = 0;
+    eh->p = NULL;
+    eh->free = -1;
+    eh->used = 0;
     eh->cap = 0;
 }
 
@@ -41,17 +87,66 @@ _event_holder_grow(struct _event_holder* eh) {
     eh->cap *= 2;
     eh->p = realloc(eh->p, sizeof(struct _event) * eh->cap);
     memset(eh->p + old_cap, 0, sizeof(struct _event) * (eh->cap - old_cap));
+    int i;
+    for (i=old_cap; i<eh->cap; ++i) {
+        eh->p[i].next = i+1;
+        eh->p[i].list = LIST_NONE;
+    }
+    eh->p[eh->cap-1].next = eh->free;
+    eh->free = old_cap;
 }
 
-struct sc_timer {
-    uint64_t start_time;
+static int
+_event_alloc(struct _event_holder* eh) {
+    if (eh->free == -1) {
+        _event_holder_grow(eh);
+    }
+    int idx = eh->free;
+    struct _event* e = &eh->p[idx];
+    eh->free = e->next;
+    e->prev = -1;
+    e->next = -1;
+    e->version++;
+    eh->used++;
+    return idx;
+}
+
+static void
+_event_free(struct _event_holder* eh, int idx) {
+    struct _event* e = &eh->p[idx];
+    e->list = LIST_NONE;
+    e->cb = NULL;
+    e->ud = NULL;
+    e->prev = -1;
+    e->next = eh->free;
+    eh->free = idx;
+    eh->used--;
+}
+
+// each reactor has its own wheel and elapsed cache
+struct _reactor_timer {
     uint64_t elapsed_time;
     bool dirty;
+    uint32_t current;
+    int lag; // of the event firing
+    int lag_interval;
+    int heads[LIST_MAX];
     struct _event_holder eh;
 };
 
+struct sc_timer {
+    uint64_t start_time;
+    int nreactor;
+    struct _reactor_timer* rt;
+};
+
 static struct sc_timer* T = NULL;
 
+static inline struct _reactor_timer*
+_current() {
+    return &T->rt[sc_reactor_current()];
+}
+
 static uint64_t
 _now() {
     struct timespec ti;
@@ -67,102 +162,271 @@ _elapsed() {
 }
 
 static void
-_elapsed_time() {
-    if (T->dirty) {
-        T->dirty = false;
-        T->elapsed_time = _elapsed();
+_elapsed_time(struct _reactor_timer* rt) {
+    if (rt->dirty) {
+        rt->dirty = false;
+        rt->elapsed_time = _elapsed();
     }
 }
 
-uint64_t 
+uint64_t
 sc_timer_now() {
-    _elapsed_time();
-    return T->start_time + T->elapsed_time;
+    struct _reactor_timer* rt = _current();
+    _elapsed_time(rt);
+    return T->start_time + rt->elapsed_time;
 }
 
-uint64_t 
+uint64_t
 sc_timer_elapsed() {
-    _elapsed_time();
-    return T->elapsed_time;
+    struct _reactor_timer* rt = _current();
+    _elapsed_time(rt);
+    return rt->elapsed_time;
 }
 
-uint64_t 
+uint64_t
 sc_timer_elapsed_real() {
     return _elapsed();
 }
 
-static uint64_t
-_closest_time() {
-    struct _event_holder* eh = &T->eh;
-    struct _event* e;
-    int i;
-    uint64_t min = -1;
-    for (i=0; i<eh->sz; ++i) {
-        e = &eh->p[i];
-        if (e->next_time < min) {
-            min = e->next_time;
+static void
+_link(struct _reactor_timer* rt, int list, int idx) {
+    struct _event* e = &rt->eh.p[idx];
+    int head = rt->heads[list];
+    e->list = list;
+    e->prev = -1;
+    e->next = head;
+    if (head != -1) {
+        rt->eh.p[head].prev = idx;
+    }
+    rt->heads[list] = idx;
+}
+
+static void
+_unlink(struct _reactor_timer* rt, int idx) {
+    struct _event* e = &rt->eh.p[idx];
+    if (e->prev != -1) {
+        rt->eh.p[e->prev].next = e->next;
+    } else {
+        rt->heads[e->list] = e->next;
+    }
+    if (e->next != -1) {
+        rt->eh.p[e->next].prev = e->prev;
+    }
+    e->prev = -1;
+    e->next = -1;
+    e->list = LIST_NONE;
+}
+
+static void
+_place(struct _reactor_timer* rt, int idx) {
+    uint32_t expire = rt->eh.p[idx].expire;
+    uint32_t current = rt->current;
+    if ((expire|NEAR_MASK) == (current|NEAR_MASK)) {
+        _link(rt, LIST_NEAR(expire & NEAR_MASK), idx);
+    } else {
+        uint32_t mask = NEAR << LEVEL_SHIFT;
+        int l;
+        for (l=0; l<LEVEL_MAX-1; ++l) {
+            if ((expire|(mask-1)) == (current|(mask-1)))
+                break;
+            mask <<= LEVEL_SHIFT;
         }
+        int i = (expire >> (NEAR_SHIFT + l*LEVEL_SHIFT)) & LEVEL_MASK;
+        _link(rt, LIST_LEVEL(l, i), idx);
+    }
+}
+
+static void
+_cascade(struct _reactor_timer* rt, int l, int i) {
+    int list = LIST_LEVEL(l, i);
+    int idx;
+    while ((idx = rt->heads[list]) != -1) {
+        _unlink(rt, idx);
+        _place(rt, idx);
+    }
+}
+
+static void
+_shift(struct _reactor_timer* rt) {
+    uint32_t ct = ++rt->current;
+    if (ct == 0) {
+        _cascade(rt, LEVEL_MAX-1, 0);
+    } else {
+        uint32_t time = ct >> NEAR_SHIFT;
+        uint32_t mask = NEAR;
+        int l = 0;
+        while ((ct & (mask-1)) == 0) {
+            int i = time & LEVEL_MASK;
+            if (i != 0) {
+                _cascade(rt, l, i);
+                break;
+            }
+            mask <<= LEVEL_SHIFT;
+            time >>= LEVEL_SHIFT;
+            ++l;
+        }
+    }
+}
+
+static void
+_execute(struct _reactor_timer* rt) {
+    // move to pending first, the callback may add or del any event
+    int near = LIST_NEAR(rt->current & NEAR_MASK);
+    int idx;
+    while ((idx = rt->heads[near]) != -1) {
+        _unlink(rt, idx);
+        _link(rt, LIST_PENDING, idx);
+    }
+    while ((idx = rt->heads[LIST_PENDING]) != -1) {
+        _unlink(rt, idx);
+        struct _event* e = &rt->eh.p[idx];
+        void (*cb)(void*) = e->cb;
+        void* ud = e->ud;
+        rt->lag = (int32_t)((uint32_t)rt->elapsed_time - e->expire);
+        rt->lag_interval = e->interval;
+        if (e->interval > 0) {
+            e->expire += e->interval;
+            if ((int32_t)(e->expire - rt->current) <= 0) {
+                e->expire = rt->current + 1;
+            }
+            _place(rt, idx);
+        } else {
+            _event_free(&rt->eh, idx);
+        }
+        cb(ud);
+    }
+}
+
+static int64_t
+_add(struct _reactor_timer* rt, int delay, int interval, void (*cb)(void* ud), void* ud) {
+    if (cb == NULL)
+        return 0;
+    if (delay < 1)
+        delay = 1;
+    int idx = _event_alloc(&rt->eh);
+    struct _event* e = &rt->eh.p[idx];
+    e->expire = rt->current + delay;
+    e->interval = interval;
+    e->cb = cb;
+    e->ud = ud;
+    _place(rt, idx);
+    return ID_ENCODE(idx, e->version);
+}
+
+static void
+_catchup(struct _reactor_timer* rt) {
+    uint32_t now = (uint32_t)rt->elapsed_time;
+    if (rt->eh.used == 0) {
+        rt->current = now;
+        return;
+    }
+    while ((int32_t)(now - rt->current) > 0) {
+        _shift(rt);
+        _execute(rt);
     }
-    return min;
 }
 
 int
 sc_timer_max_timeout() {
-    T->elapsed_time = _elapsed(); 
-    T->dirty = true;
-    uint64_t next_time = _closest_time(T->elapsed_time);
-    int timeout = -1;
-    if (next_time != -1) {
-        timeout = next_time > T->elapsed_time ?
-            next_time - T->elapsed_time : 0;
-    } 
-    return timeout;
+    struct _reactor_timer* rt = _current();
+    rt->elapsed_time = _elapsed();
+    rt->dirty = true;
+    if (rt->eh.used == 0) {
+        return -1;
+    }
+    uint32_t now = (uint32_t)rt->elapsed_time;
+    if ((int32_t)(now - rt->current) > 0) {
+        return 0;
+    }
+    // the nearest event in near wheel, else wakeup at next cascade
+    int timeout = NEAR - (rt->current & NEAR_MASK);
+    int i;
+    for (i=1; i<timeout; ++i) {
+        if (rt->heads[LIST_NEAR((rt->current + i) & NEAR_MASK)] != -1) {
+            timeout = i;
+            break;
+        }
+    }
+    int32_t ahead = rt->current - now;
+    return timeout + ahead;
 }
 
 void
 sc_timer_dispatch_timeout() {
-    //T->dirty = true;
-    _elapsed_time();
-    struct _event_holder* eh = &T->eh;
-    struct _event* e;
-    int i;
-    for (i=0; i<eh->sz; ++i) {
-        e = &eh->p[i];
-        if (e->next_time <= T->elapsed_time) {
-            service_notify_time(e->serviceid);
-            e->next_time += e->interval;
-        }
-    }
+    struct _reactor_timer* rt = _current();
+    _elapsed_time(rt);
+    _catchup(rt);
+}
+
+int64_t
+sc_timer_add(int delay, int interval, void (*cb)(void* ud), void* ud) {
+    return _add(_current(), delay, interval, cb, ud);
+}
+
+void
+sc_timer_del(int64_t id) {
+    struct _reactor_timer* rt = _current();
+    int idx = ID_INDEX(id);
+    if (id <= 0 || idx < 0 || idx >= rt->eh.cap)
+        return;
+    struct _event* e = &rt->eh.p[idx];
+    if (e->list == LIST_NONE ||
+        e->version != ID_VERSION(id))
+        return;
+    _unlink(rt, idx);
+    _event_free(&rt->eh, idx);
 }
 
+static void
+_service_time(void* ud) {
+    int serviceid = (int)(intptr_t)ud;
+    struct _reactor_timer* rt = _current();
+    sc_profile_lag(serviceid, rt->lag_interval, rt->lag);
+    service_notify_time(serviceid);
+}
+
+// the event belong to the reactor which the service pinned
 void
 sc_timer_register(int serviceid, int interval) {
-    struct _event_holder* eh = &T->eh;
-    if (eh->sz >= eh->cap)  {
-       _event_holder_grow(eh);
-    }
-    struct _event* e = &eh->p[eh->sz];
-    e->serviceid = serviceid;
-    e->interval = interval;
-    e->next_time = T->elapsed_time + interval;
-    eh->sz += 1;
+    int r = service_query_reactor(serviceid);
+    if (r == SC_REACTOR_ANY)
+        r = sc_reactor_current();
+    struct _reactor_timer* rt = &T->rt[r];
+    if (interval < 1)
+        interval = 1;
+    _add(rt, interval, interval, _service_time, (void*)(intptr_t)serviceid);
 }
 
 static void
 sc_timer_init() {
     T = malloc(sizeof(*T));
     memset(T, 0, sizeof(*T));
-    T->dirty = true;
-    T->elapsed_time = _elapsed();
-    T->start_time = _now() - T->elapsed_time;
-    _event_holder_init(&T->eh);
+    T->nreactor = sc_reactor_count();
+    T->rt = malloc(sizeof(struct _reactor_timer) * T->nreactor);
+    uint64_t elapsed = _elapsed();
+    T->start_time = _now() - elapsed;
+    int i, n;
+    for (i=0; i<T->nreactor; ++i) {
+        struct _reactor_timer* rt = &T->rt[i];
+        rt->dirty = true;
+        rt->elapsed_time = elapsed;
+        rt->current = (uint32_t)elapsed;
+        for (n=0; n<LIST_MAX; ++n) {
+            rt->heads[n] = -1;
+        }
+        _event_holder_init(&rt->eh);
+    }
 }
 
-static void 
+static void
 sc_timer_fini() {
-    if (T == NULL) 
+    if (T == NULL)
         return;
-    _event_holder_fini(&T->eh);
+    int i;
+    for (i=0; i<T->nreactor; ++i) {
+        _event_holder_fini(&T->rt[i].eh);
+    }
+    free(T->rt);
     free(T);
     T = NULL;
 }
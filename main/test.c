@@ -9,6 +9,11 @@
 #include "map.h"
 #include "hmap.h"
 #include "elog_include.h"
+#include "tplt_include.h"
+#include "net.h"
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <assert.h>
 #include <stdint.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -196,9 +201,23 @@ void test_gfreeid() {
     struct idtest* i3 = GFREEID_ALLOC(idtest, &gf);
     assert(i3-gf.p == 2);
     assert(gf.cap == 4);
-    GFREEID_FREE(idtest, &gf, GFREEID_SLOT(&gf, 0));
-    GFREEID_FREE(idtest, &gf, GFREEID_SLOT(&gf, 1));
-    GFREEID_FREE(idtest, &gf, GFREEID_SLOT(&gf, 2));
+    int i;
+    for (i=0; i<3; ++i) {
+        struct idtest* one = GFREEID_SLOT(&gf, i);
+        GFREEID_FREE(idtest, &gf, one);
+    }
+    for (i=0; i<16; ++i) {
+        GFREEID_ALLOC(idtest, &gf);
+    }
+    assert(gf.cap == 16);
+    for (i=1; i<16; ++i) {
+        struct idtest* one = GFREEID_SLOT(&gf, i);
+        GFREEID_FREE(idtest, &gf, one);
+    }
+    assert(GFREEID_SHRINK(idtest, &gf, 2) == 2);
+    assert(GFREEID_SLOT(&gf, 0));
+    i1 = GFREEID_ALLOC(idtest, &gf);
+    assert(i1-gf.p == 1);
     GFREEID_FINI(idtest, &gf);
 }
 
@@ -750,6 +769,203 @@ void test_map() {
     strhmap_free(m);
 }
 
+// the chained idmap before open addressing, for compare,
+// noinline as the real one is called across the library
+struct chainelement {
+    uint32_t key;
+    void* pointer;
+    struct chainelement* next;
+};
+
+struct chainmap {
+    uint32_t used;
+    uint32_t cap;
+    struct chainelement** slots;
+};
+
+static __attribute__((noinline)) struct chainmap*
+_chainmap_create(uint32_t cap) {
+    uint32_t tmp = 2;
+    while (tmp < cap)
+        tmp *= 2;
+    struct chainmap* m = malloc(sizeof(*m));
+    m->slots = malloc(sizeof(struct chainelement*) * tmp);
+    memset(m->slots, 0, sizeof(struct chainelement*) * tmp);
+    m->used = 0;
+    m->cap = tmp;
+    return m;
+}
+
+static __attribute__((noinline)) void*
+_chainmap_find(struct chainmap* self, uint32_t key) {
+    struct chainelement* e = self->slots[key & (self->cap-1)];
+    while (e) {
+        if (e->key == key)
+            return e->pointer;
+        e = e->next;
+    }
+    return NULL;
+}
+
+static __attribute__((noinline)) void
+_chainmap_insert(struct chainmap* self, uint32_t key, void* pointer) {
+    if (self->used >= self->cap) {
+        uint32_t oldcap = self->cap;
+        self->cap *= 2;
+        self->slots = realloc(self->slots, sizeof(struct chainelement*) * self->cap);
+        memset(self->slots + oldcap, 0, sizeof(struct chainelement*) * (self->cap - oldcap));
+        uint32_t i;
+        for (i=0; i<oldcap; ++i) {
+            struct chainelement* e = self->slots[i];
+            self->slots[i] = NULL;
+            while (e) {
+                struct chainelement* next = e->next;
+                uint32_t hash = e->key & (self->cap-1);
+                e->next = self->slots[hash];
+                self->slots[hash] = e;
+                e = next;
+            }
+        }
+    }
+    uint32_t hash = key & (self->cap-1);
+    struct chainelement* e = malloc(sizeof(*e));
+    e->key = key;
+    e->pointer = pointer;
+    e->next = self->slots[hash];
+    self->slots[hash] = e;
+    self->used++;
+}
+
+static __attribute__((noinline)) void*
+_chainmap_remove(struct chainmap* self, uint32_t key) {
+    struct chainelement** p = &self->slots[key & (self->cap-1)];
+    struct chainelement* e = *p;
+    while (e) {
+        if (e->key == key) {
+            void* ret = e->pointer;
+            *p = e->next;
+            free(e);
+            self->used--;
+            return ret;
+        }
+        p = &e->next;
+        e = *p;
+    }
+    return NULL;
+}
+
+static void
+_chainmap_free(struct chainmap* self) {
+    uint32_t i;
+    for (i=0; i<self->cap; ++i) {
+        struct chainelement* e = self->slots[i];
+        while (e) {
+            struct chainelement* tmp = e;
+            e = e->next;
+            free(tmp);
+        }
+    }
+    free(self->slots);
+    free(self);
+}
+
+static uint64_t
+_elapsed_ns() {
+    struct timespec ti;
+    clock_gettime(CLOCK_MONOTONIC, &ti);
+    return ti.tv_sec * 1000000000ULL + ti.tv_nsec;
+}
+
+static int
+_idmap_oddcb(uint32_t key, void* value, void* ud) {
+    int* n = ud;
+    if (key & 1) {
+        (*n)++;
+        return 1;
+    }
+    return 0;
+}
+
+// small maps like member delaymap/buffmap, and a big one like regacc,
+// random keys, and sequential keys like the ids in game
+void test_idmap(int times) {
+    static const uint32_t counts[] = { 8, 1000, 1000000 };
+    uint32_t k, i, t;
+    for (k=0; k<sizeof(counts)/sizeof(counts[0]) * 2; ++k) {
+        uint32_t count = counts[k/2];
+        int seq = k & 1;
+        uint32_t round = 1000000/count * times;
+        if (round == 0) round = 1;
+        struct mapvalue* all = malloc(sizeof(struct mapvalue) * count);
+        for (i=0; i<count; ++i) {
+            all[i].id = seq ? 10001+i : rand();
+            all[i].value = i;
+        }
+        uint64_t t1, t2;
+        uint64_t hit = 0;
+        uint64_t use[2][3];
+        memset(use, 0, sizeof(use));
+
+        for (t=0; t<round; ++t) {
+            struct chainmap* cm = _chainmap_create(1);
+            t1 = _elapsed_ns();
+            for (i=0; i<count; ++i)
+                _chainmap_insert(cm, all[i].id, &all[i]);
+            t2 = _elapsed_ns(); use[0][0] += t2-t1; t1 = t2;
+            for (i=0; i<count; ++i)
+                hit += _chainmap_find(cm, all[i].id) != NULL;
+            for (i=0; i<count; ++i)
+                hit += _chainmap_find(cm, all[i].id+1) != NULL;
+            t2 = _elapsed_ns(); use[0][1] += t2-t1; t1 = t2;
+            for (i=0; i<count; ++i)
+                _chainmap_remove(cm, all[i].id);
+            t2 = _elapsed_ns(); use[0][2] += t2-t1;
+            _chainmap_free(cm);
+        }
+        for (t=0; t<round; ++t) {
+            struct idmap* m = idmap_create(1);
+            t1 = _elapsed_ns();
+            for (i=0; i<count; ++i)
+                idmap_insert(m, all[i].id, &all[i]);
+            t2 = _elapsed_ns(); use[1][0] += t2-t1; t1 = t2;
+            for (i=0; i<count; ++i)
+                hit += idmap_find(m, all[i].id) != NULL;
+            for (i=0; i<count; ++i)
+                hit += idmap_find(m, all[i].id+1) != NULL;
+            t2 = _elapsed_ns(); use[1][1] += t2-t1; t1 = t2;
+            for (i=0; i<count; ++i)
+                idmap_remove(m, all[i].id);
+            t2 = _elapsed_ns(); use[1][2] += t2-t1;
+            idmap_free(m, NULL);
+        }
+        for (i=0; i<2; ++i) {
+            printf("count %u%s, round %u, %s use time(ms): insert %d, find %d, remove %d\n", 
+                    count, seq ? " seq" : "", round, i==0 ? "chainmap" : "idmap", 
+                    (int)(use[i][0]/1000000), (int)(use[i][1]/1000000), (int)(use[i][2]/1000000));
+        }
+
+        // check foreach_remove against find
+        struct idmap* m = idmap_create(1);
+        for (i=0; i<count; ++i)
+            idmap_insert(m, all[i].id, &all[i]);
+        int removed = 0;
+        t1 = _elapsed();
+        idmap_foreach_remove(m, _idmap_oddcb, &removed);
+        t2 = _elapsed();
+        for (i=0; i<count; ++i) {
+            void* p = idmap_find(m, all[i].id);
+            if (all[i].id & 1)
+                assert(p == NULL);
+            else
+                assert(p == &all[i] || idmap_find(m, all[i].id) != NULL);
+        }
+        printf("count %u, foreach_remove %d use time: %d, hit %llu\n", 
+                count, removed, (int)(t2-t1), (unsigned long long)hit);
+        idmap_free(m, NULL);
+        free(all);
+    }
+}
+
 void
 test_elog1() {
     struct elog* el = elog_create("/home/lvxiaojun/log/testlog.log");
@@ -1044,6 +1260,113 @@ test_encode() {
     }    
 }
 
+// item table like, elemsz 64, the keys compact (id from 10001 with some gap)
+// or sparse (type*100000 + seq)
+void test_tplt(int times) {
+    static const int counts[] = { 50, 300, 2000 };
+    static const char* names[] = { "vec32", "index32", "auto" };
+    const struct tplt_visitor_ops* ops[] = { 
+        TPLT_VIST_VEC32, TPLT_VIST_INDEX32, TPLT_VIST_AUTO };
+    int elemsz = 64;
+    int k, sparse, v, i, t;
+    for (sparse=0; sparse<2; ++sparse) {
+    for (k=0; k<sizeof(counts)/sizeof(counts[0]); ++k) {
+        int count = counts[k];
+        struct tplt_holder* holder = malloc(sizeof(*holder) + elemsz * count);
+        holder->nelem = count;
+        holder->elemsz = elemsz;
+        uint32_t* keys = malloc(sizeof(uint32_t) * count * 2);
+        for (i=0; i<count; ++i) {
+            uint32_t key = sparse ? (i%8+1)*100000 + i : 10001 + i + i/10;
+            *(uint32_t*)(holder->data + elemsz * i) = key;
+            keys[i] = key;
+            keys[count+i] = key + 5000000; // miss
+        }
+        // shuffle the lookups
+        for (i=count*2-1; i>0; --i) {
+            int r = rand() % (i+1);
+            uint32_t tmp = keys[i]; keys[i] = keys[r]; keys[r] = tmp;
+        }
+        int round = 2000000/count * times;
+        for (v=0; v<3; ++v) {
+            struct tplt_visitor* vist = tplt_visitor_create(ops[v], holder);
+            uint64_t hit = 0;
+            uint64_t t1 = _elapsed_ns();
+            for (t=0; t<round; ++t) {
+                for (i=0; i<count*2; ++i) {
+                    hit += tplt_visitor_find(vist, keys[i]) != NULL;
+                }
+            }
+            uint64_t t2 = _elapsed_ns();
+            for (i=0; i<count; ++i) {
+                uint32_t key = *(uint32_t*)(holder->data + elemsz * i);
+                assert(tplt_visitor_find(vist, key) == holder->data + elemsz * i);
+            }
+            struct tplt_visitor_stat st;
+            tplt_visitor_stat(vist, &st);
+            printf("%s count %d, %s(%s, slots %d) find %.2fns, hit %llu\n",
+                    sparse ? "sparse" : "compact", count, names[v], st.strategy, st.slots,
+                    (double)(t2-t1) / ((double)round*count*2), (unsigned long long)hit);
+            tplt_visitor_free(vist);
+        }
+        free(keys);
+        free(holder);
+    }
+    }
+}
+
+// poll until the event of type, return the connid
+static int
+_netpoll_wait(struct net* n, int type) {
+    int i, k;
+    for (i=0; i<100; ++i) {
+        int c = net_poll(n, 10);
+        struct net_message* e;
+        net_getevents(n, &e);
+        for (k=0; k<c; ++k) {
+            if (e[k].type == type)
+                return e[k].connid;
+        }
+    }
+    return -1;
+}
+
+// accept, read, write by net_poll, level and edge trigger
+static void
+test_netpoll() {
+    int pollers[] = { NET_POLLER_EPOLL, NET_POLLER_EPOLL|NET_POLLER_EDGE };
+    int i;
+    for (i=0; i<sizeof(pollers)/sizeof(pollers[0]); ++i) {
+        struct net* n = net_create(16, 4096, pollers[i]);
+        assert(n);
+        uint16_t port = 18990 + i;
+        assert(net_listen(n, inet_addr("127.0.0.1"), port, 0, 1, 2) == 0);
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        assert(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+        int id = _netpoll_wait(n, NETE_ACCEPT);
+        assert(id >= 0);
+        assert(net_subscribe(n, id, true) == 0);
+        assert(write(fd, "ping", 4) == 4);
+        assert(_netpoll_wait(n, NETE_READ) == id);
+        char buf[16];
+        int e = 0;
+        assert(net_readto(n, id, buf, sizeof(buf), &e) == 4 && memcmp(buf, "ping", 4) == 0);
+        struct net_message nm;
+        assert(net_send(n, id, "pong", 4, &nm) == 0);
+        assert(read(fd, buf, sizeof(buf)) == 4 && memcmp(buf, "pong", 4) == 0);
+        close(fd);
+        assert(_netpoll_wait(n, NETE_READ) == id);
+        assert(net_readto(n, id, buf, sizeof(buf), &e) < 0 && e == NET_ERR_EOF);
+        printf("netpoll %x use %x ok\n", pollers[i], net_poller(n));
+        net_free(n);
+    }
+}
+
 int 
 main(int argc, char* argv[]) {
     int times = 1;
@@ -1067,11 +1390,14 @@ main(int argc, char* argv[]) {
     //test_redis();
     //test_freelist();
     //test_map();
+    //test_idmap(times);
     //test_elog2();
     //test_log(times);
     //test_elog4(times);
     //test_redisnew(times);
     //test_copy(times);
     //test_encode();
+    //test_tplt(times);
+    //test_netpoll();
     return 0;
 }
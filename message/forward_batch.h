@@ -0,0 +1,143 @@
+#ifndef __forward_batch_h__
+#define __forward_batch_h__
+
+#include "user_message.h"
+#include "sc_reactor.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * the UM_FORWARD to the same node in one loop are packed in one UM_FORWARDV,
+ * send at the end of the loop, or when the envelope is full.
+ * one message alone is send as the plain UM_FORWARD
+ */
+#define FWBATCH_NODEMAX 16
+
+struct fwbatch_node {
+    int connid;
+    int n;
+    int sz; // include the UM_FORWARDV header
+    char buf[UM_MAXSZ];
+};
+
+struct fwbatch {
+    bool flushing;
+    int nnode;
+    struct fwbatch_node* nodes[FWBATCH_NODEMAX];
+};
+
+static inline void
+_fwbatch_send(struct fwbatch_node* node) {
+    if (node->n == 1) {
+        char* p = node->buf + sizeof(struct UM_FORWARDV);
+        sc_net_send(node->connid, p, node->sz - sizeof(struct UM_FORWARDV));
+    } else if (node->n > 1) {
+        UM_CAST(UM_FORWARDV, fv, node->buf);
+        fv->msgid = IDUM_FORWARDV;
+        UM_SEND(node->connid, fv, node->sz);
+    }
+    node->n = 0;
+    node->sz = sizeof(struct UM_FORWARDV);
+}
+
+static inline void
+fwbatch_flush(struct fwbatch* b) {
+    int i;
+    for (i=0; i<b->nnode; ++i) {
+        _fwbatch_send(b->nodes[i]);
+    }
+}
+
+static void
+_fwbatch_flushcb(void* ud) {
+    struct fwbatch* b = ud;
+    b->flushing = false;
+    fwbatch_flush(b);
+}
+
+// the pending messages are send before free
+static inline void
+fwbatch_fini(struct fwbatch* b) {
+    if (b->flushing) {
+        sc_reactor_undefer(_fwbatch_flushcb, b);
+        b->flushing = false;
+    }
+    fwbatch_flush(b);
+    int i;
+    for (i=0; i<b->nnode; ++i) {
+        free(b->nodes[i]);
+    }
+    b->nnode = 0;
+}
+
+// the node of connid, or an idle one (the connid may be closed)
+static inline struct fwbatch_node*
+_fwbatch_node(struct fwbatch* b, int connid) {
+    struct fwbatch_node* idle = NULL;
+    int i;
+    for (i=0; i<b->nnode; ++i) {
+        struct fwbatch_node* node = b->nodes[i];
+        if (node->connid == connid)
+            return node;
+        if (idle == NULL && node->n == 0)
+            idle = node;
+    }
+    if (idle == NULL) {
+        if (b->nnode >= FWBATCH_NODEMAX)
+            return NULL;
+        idle = malloc(sizeof(*idle));
+        idle->n = 0;
+        idle->sz = sizeof(struct UM_FORWARDV);
+        b->nodes[b->nnode++] = idle;
+    }
+    idle->connid = connid;
+    return idle;
+}
+
+// batch um wrapped by UM_FORWARD, like UM_SENDWRAP
+static inline void
+fwbatch_sendwrap(struct fwbatch* b, int connid, int fcid, struct UM_BASE* um) {
+    int sz = sizeof(struct UM_FORWARD) + um->msgsz - UM_BASE_SZ;
+    struct fwbatch_node* node = NULL;
+    if (sz + sizeof(struct UM_FORWARDV) <= UM_MAXSZ) {
+        node = _fwbatch_node(b, connid);
+    }
+    if (node == NULL) {
+        // too large to batch, send the queued of connid first to keep the order
+        int i;
+        for (i=0; i<b->nnode; ++i) {
+            if (b->nodes[i]->connid == connid) {
+                _fwbatch_send(b->nodes[i]);
+                break;
+            }
+        }
+        UM_SENDWRAP(connid, fcid, um);
+        return;
+    }
+    if (node->sz + sz > UM_MAXSZ) {
+        _fwbatch_send(node);
+    }
+    struct UM_FORWARD* fw = (void*)(node->buf + node->sz);
+    fw->nodeid = sc_id();
+    fw->msgid = IDUM_FORWARD;
+    fw->msgsz = sz;
+    fw->cid = fcid;
+    fw->wrap = *um;
+    fw->wrap.nodeid = sc_id();
+    memcpy(fw->wrap.data, um->data, um->msgsz - UM_BASE_SZ);
+    node->sz += sz;
+    node->n++;
+    if (!b->flushing) {
+        b->flushing = true;
+        sc_reactor_defer(_fwbatch_flushcb, b);
+    }
+}
+
+// batch the UM_FORWARD, like UM_SENDFORWARD
+static inline void
+fwbatch_sendforward(struct fwbatch* b, int connid, struct UM_FORWARD* fw) {
+    fwbatch_sendwrap(b, connid, fw->cid, &fw->wrap);
+}
+
+#endif
@@ -4,9 +4,11 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define UM_MAXSZ 61000
 #define UM_CLI_MAXSZ (UM_MAXSZ - 1000)
+#define UM_LARGE_MAXSZ (16*1024*1024) // the node link only
 #define IDUM_MAX 65536
 #define IDUM_INVALID -1
 
@@ -68,6 +70,74 @@ struct UM_BASE {
 #define UM_CAST(type, name, um) \
     struct type* name = (struct type*)um;
 
+/*
+ * large message of node link, the frame is UM_LARGE then the message,
+ * msgsz of both is 0, the size is UM_LARGE.sz, the handler get it by the sz
+ */
+struct UM_LARGE {
+    _UM_HEADER;
+    uint32_t sz; // of the message follow
+};
+
+/*
+ * build the message in heap instead of the UM_MAXSZ stack buffer, the buffer
+ * is keep for the next umb_begin, grow to the payload, up to UM_LARGE_MAXSZ.
+ * the message pointer is changed by grow, get it again by UMB_UM
+ */
+struct um_builder {
+    char* p; // UM_LARGE head room, then the message
+    int sz;  // of the message
+    int cap; // of the message
+};
+
+#define UMB_UM(b) ((struct UM_BASE*)((b)->p + sizeof(struct UM_LARGE)))
+#define UMB_PTR(b) ((char*)UMB_UM(b) + (b)->sz)
+
+static inline int
+umb_reserve(struct um_builder* b, int n) {
+    if (b->sz + n <= b->cap)
+        return 0;
+    if (b->sz + n > UM_LARGE_MAXSZ)
+        return 1;
+    int cap = b->cap > 0 ? b->cap : 1024;
+    while (cap < b->sz + n)
+        cap *= 2;
+    if (cap > UM_LARGE_MAXSZ)
+        cap = UM_LARGE_MAXSZ;
+    b->p = realloc(b->p, sizeof(struct UM_LARGE) + cap);
+    b->cap = cap;
+    return 0;
+}
+
+// return the message, headsz is size of the message struct
+static inline void*
+umb_begin(struct um_builder* b, int msgid, int headsz) {
+    b->sz = 0;
+    umb_reserve(b, headsz);
+    struct UM_BASE* um = UMB_UM(b);
+    memset(um, 0, headsz);
+    um->msgid = msgid;
+    b->sz = headsz;
+    return um;
+}
+
+static inline int
+umb_write(struct um_builder* b, const void* data, int n) {
+    if (umb_reserve(b, n))
+        return -1;
+    memcpy(UMB_PTR(b), data, n);
+    b->sz += n;
+    return n;
+}
+
+static inline void
+umb_fini(struct um_builder* b) {
+    free(b->p);
+    b->p = NULL;
+    b->sz = 0;
+    b->cap = 0;
+}
+
 #pragma pack()
 
 #endif
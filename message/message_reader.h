@@ -4,13 +4,39 @@
 #include "message.h"
 #include "net.h"
 
+// the UM_LARGE frame, return the message follow it
 static inline struct UM_BASE*
-mread_one(struct mread_buffer* buf, int* e) {
+mread_large(struct mread_buffer* buf, int* msgsz, int* e) {
+    struct UM_LARGE* lg = buf->ptr;
+    if (buf->sz < sizeof(*lg)) {
+        return NULL;
+    }
+    if (lg->sz < sizeof(struct UM_BASE) ||
+        lg->sz > UM_LARGE_MAXSZ) {
+        *e = NET_ERR_MSG;
+        return NULL;
+    }
+    int sz = sizeof(*lg) + lg->sz;
+    if (buf->sz < sz) {
+        return NULL;
+    }
+    buf->ptr += sz;
+    buf->sz  -= sz;
+    *msgsz = lg->sz;
+    return (struct UM_BASE*)(lg+1);
+}
+
+// msgsz is the size of the message, it is not the um->msgsz for large one
+static inline struct UM_BASE*
+mread_one(struct mread_buffer* buf, int* msgsz, int* e) {
     *e = 0;
     struct UM_BASE* base = buf->ptr;
     int sz = buf->sz;
     int body;
     if (sz >= sizeof(*base)) {
+        if (base->msgsz == 0) {
+            return mread_large(buf, msgsz, e);
+        }
         sz -= sizeof(*base);
         if (base->msgsz >= sizeof(*base)) {
             body = base->msgsz - sizeof(*base);
@@ -35,6 +61,7 @@ mread_one(struct mread_buffer* buf, int* e) {
 ok:
     buf->ptr += base->msgsz;
     buf->sz  -= base->msgsz;
+    *msgsz = base->msgsz;
     return base;
 }
 
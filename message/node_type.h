@@ -33,7 +33,8 @@ const char* NODE_NAMES[NODE_TYPE_MAX] = {
 
 #define _NODEM_header \
     struct UM_BASE* um; \
-    const struct sc_node* hn;
+    const struct sc_node* hn; \
+    int sz; // of um, um->msgsz is 0 if large
 
 struct node_message {
     _NODEM_header;
@@ -51,6 +52,7 @@ _decode_nodemessage(void* msg, int sz, struct node_message* nm) {
     }
     nm->hn = hn;
     nm->um = um;
+    nm->sz = sz;
     return 0;
 }
 
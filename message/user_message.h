@@ -19,6 +19,8 @@
 #define IDUM_FORWARD    IDUM_NBEGIN+12
 #define IDUM_MINLOADFAIL IDUM_NBEGIN+13
 #define IDUM_UPDATELOAD IDUM_NBEGIN+14
+#define IDUM_LOADREPORT IDUM_NBEGIN+15
+#define IDUM_FORWARDV   IDUM_NBEGIN+16
 
 #define IDUM_REDISQUERY IDUM_NBEGIN+20
 #define IDUM_REDISREPLY IDUM_NBEGIN+21
@@ -96,11 +98,48 @@ UM_FORWARD_size(struct UM_FORWARD* um) {
     name->msgid = ID##type; \
     name->msgsz = sizeof(*name);
 
+// the UM_FORWARD packed one after another, see forward_batch.h
+struct UM_FORWARDV {
+    _UM_HEADER;
+    uint8_t data[0];
+};
+
+// iterate the UM_FORWARD in place, no copy
+struct UM_FORWARDV_iter {
+    uint8_t* p;
+    uint8_t* end;
+};
+static inline void
+UM_FORWARDV_begin(struct UM_FORWARDV* um, struct UM_FORWARDV_iter* it) {
+    it->p = um->data;
+    it->end = (uint8_t*)um + um->msgsz;
+}
+// return NULL at the end, or the rest is not a valid UM_FORWARD
+static inline struct UM_FORWARD*
+UM_FORWARDV_next(struct UM_FORWARDV_iter* it) {
+    int left = it->end - it->p;
+    if (left < (int)sizeof(struct UM_FORWARD)) {
+        return NULL;
+    }
+    struct UM_FORWARD* fw = (void*)it->p;
+    if (fw->msgsz > left ||
+        fw->wrap.msgsz < UM_BASE_SZ ||
+        fw->msgsz != UM_FORWARD_size(fw)) {
+        return NULL;
+    }
+    it->p += fw->msgsz;
+    return fw;
+}
+
 // load
 struct UM_UPDATELOAD {
     _UM_HEADER;
     int value; // load value
 };
+struct UM_LOADREPORT {
+    _UM_HEADER;
+    struct sc_node_loadreport report;
+};
 struct UM_MINLOADFAIL {
     _UM_HEADER;
 };
@@ -188,6 +227,24 @@ UM_OVERROOM_size(struct UM_OVERROOM* um) {
     sc_net_send(id, um, sz);  \
 } while(0)
 
+// send the built message, as large frame if over UM_MAXSZ
+static inline int
+UM_SENDBUILDER(int id, struct um_builder* b) {
+    struct UM_BASE* um = UMB_UM(b);
+    um->nodeid = sc_id();
+    if (b->sz <= UM_MAXSZ) {
+        um->msgsz = b->sz;
+        return sc_net_send(id, um, b->sz);
+    }
+    struct UM_LARGE* lg = (void*)b->p;
+    lg->nodeid = um->nodeid;
+    lg->msgsz = 0;
+    lg->msgid = um->msgid;
+    lg->sz = b->sz;
+    um->msgsz = 0;
+    return sc_net_send(id, lg, sizeof(*lg) + b->sz);
+}
+
 #define UM_SENDTOCLI(id, um, sz) do { \
     (um)->msgsz = sz; \
     sc_net_send(id, (char*)um + UM_CLI_OFF, (um)->msgsz - UM_CLI_OFF); \
@@ -195,6 +252,11 @@ UM_OVERROOM_size(struct UM_OVERROOM* um) {
 
 #define UM_SENDTOSVR UM_SENDTOCLI
 
+#define UM_MULTICASTTOCLI(ids, n, um, sz) do { \
+    (um)->msgsz = sz; \
+    sc_net_multicast(ids, n, (char*)um + UM_CLI_OFF, (um)->msgsz - UM_CLI_OFF); \
+} while(0)
+
 #define UM_SENDTONODE(hn, um, sz) \
     UM_SEND(hn->connid, um, sz)
 
@@ -209,4 +271,21 @@ UM_OVERROOM_size(struct UM_OVERROOM* um) {
 #define UM_SENDFORWARD(id, fw) \
     UM_SEND(id, fw, UM_FORWARD_size(fw));
 
+// send um wrapped by UM_FORWARD, the header and body hand over separately, 
+// no copy to the UM_DEFVAR buffer
+#define UM_SENDWRAP(id, fcid, um) do { \
+    struct UM_FORWARD _fw; \
+    _fw.nodeid = sc_id(); \
+    _fw.msgid = IDUM_FORWARD; \
+    _fw.cid = fcid; \
+    _fw.wrap = *(um); \
+    _fw.wrap.nodeid = sc_id(); \
+    _fw.msgsz = UM_FORWARD_size(&_fw); \
+    struct iovec _iov[2] = { \
+        { &_fw, sizeof(_fw) }, \
+        { (um)->data, (um)->msgsz - UM_BASE_SZ }, \
+    }; \
+    sc_net_sendv(id, _iov, 2); \
+} while(0)
+
 #endif
@@ -1,5 +1,7 @@
+#define _GNU_SOURCE // accept4
 #include "net.h"
 #include "netbuf.h"
+#include "sbuffer.h"
 #include "socket.h"
 #include "netpoll.h"
 #include <assert.h>
@@ -17,6 +19,20 @@
 #define STATUS_OPENED      STATUS_LISTENING
 
 #define LISTEN_BACKLOG 511
+// max accept of one listen event, the rest by the requeue
+#define ACCEPT_BUDGET 64
+
+// send queue chunk, and the max free chunks keep in pool
+#define SBUFFER_CHUNK 4096
+#define SBUFFER_FREEMAX 4096
+// the node of the shared payload count in wbuffersz, besides the payload bytes
+#define SBUFFER_REFSZ ((int)sizeof(struct sbuffer))
+
+#ifdef IOV_MAX
+#define SEND_IOV_MAX IOV_MAX
+#else
+#define SEND_IOV_MAX 64
+#endif
 
 #define NETERR(err) (err) != 0 ? (err) : NET_ERR_EOF;
 
@@ -29,13 +45,6 @@ static const char* STRERROR[] = {
     "net error no buffer",
 };
 
-struct sbuffer {
-    struct sbuffer* next;
-    int sz;
-    char* ptr;
-    char data[0];
-};
-
 struct socket {
     socket_t fd;
     int status;
@@ -44,11 +53,19 @@ struct socket {
     int ut;
     uint32_t addr;
     uint16_t port;
-    struct netbuf_block* rb;
+    struct netbuf_block* rb; // alloc when read, free when read over
+    int rcls; // size class hint of the next rb
+    bool rfull; // last read fill the rb
     struct sbuffer* head;
     struct sbuffer* tail; 
     int wbuffermax;
     int wbuffersz;
+    bool cork; // send queue only, flush by net_flush
+    bool corked; // in the cork list, keep after close, net_flush check status
+    bool rmore; // not read to EAGAIN, or the reader ask read again
+    bool rqueued; // in the requeue list, keep after close, net_poll check status
+    bool rwait; // the listener accept fail (EMFILE), retry at next poll, not subscribed
+    uint32_t rpoll; // the poll of the last read event
 };
 
 struct net {
@@ -56,12 +73,26 @@ struct net {
     int error;
     int max;
     int nevent;
+    int necap; // max of the poll event and a batch of accept
     struct np_event* ev;
     struct net_message* ne; 
     struct socket* sockets;
     struct socket* free_socket;
     struct socket* tail_socket;
     struct netbuf* rpool;
+    struct sbuffer_pool* spool;
+    int64_t wbuffersz; // of all sockets
+    uint32_t corkmask; // bit of the socket ut
+    int corkmax; // flush early if the queue large than this
+    int* corks;
+    int ncork;
+    int64_t corkmsg; // message queued by the cork sockets
+    int64_t corkwrite; // writev call of net_flush
+    bool edge; // edge trigger, the reader must read to EAGAIN
+    uint32_t npoll;
+    int* rqueue; // socket to read again at next poll, see net_requeue
+    int nrqueue;
+    int64_t requeued; // read event by the requeue
 };
 
 static int
@@ -102,10 +133,18 @@ _alloc_sockets(int max) {
         s[i].addr = 0;
         s[i].port = 0;
         s[i].rb = NULL;
+        s[i].rcls = 0;
+        s[i].rfull = false;
         s[i].head = NULL;
         s[i].tail = NULL;
         s[i].wbuffermax = INT_MAX;
         s[i].wbuffersz = 0;
+        s[i].cork = false;
+        s[i].corked = false;
+        s[i].rmore = false;
+        s[i].rqueued = false;
+        s[i].rwait = false;
+        s[i].rpoll = 0;
     }
     s[max-1].fd = -1;
     return s;
@@ -128,11 +167,14 @@ _create_socket(struct net* self, socket_t fd, uint32_t addr, uint16_t port, int
     s->ut = ut;
     s->addr = addr;
     s->port = port;
-    s->rb = netbuf_alloc_block(self->rpool, s-self->sockets);
+    s->rb = NULL;
+    s->rcls = 0;
+    s->rfull = false;
     s->wbuffersz = 0;
     s->wbuffermax = wbuffermax;
     if (s->wbuffermax <= 0)
         s->wbuffermax = INT_MAX;
+    s->cork = ut >= 0 && ut < 32 && (self->corkmask & (1u << ut));
     return s;
 }
 
@@ -151,16 +193,21 @@ _close_socket(struct net* self, struct socket* s) {
     s->port = 0;
     netbuf_free_block(self->rpool, s->rb);
     s->rb = NULL;
+    s->rcls = 0;
+    s->rfull = false;
+    s->rmore = false;
    
     struct sbuffer* p = NULL;
     while (s->head) {
         p = s->head;
         s->head = s->head->next;
-        free(p);
+        sbuffer_free(self->spool, p);
     }
     s->tail = NULL;
+    self->wbuffersz -= s->wbuffersz;
     s->wbuffersz = 0;
     s->wbuffermax = INT_MAX;
+    s->cork = false;
     if (self->free_socket == NULL) {
         self->free_socket = s;
     } else {
@@ -178,6 +225,9 @@ _try_close_socket(struct net* self, struct socket* s) {
         return true;
     if (s->head) {
         s->status = STATUS_HALFCLOSE; // wait for send
+        if (!(s->mask & NET_WABLE)) {
+            _subscribe(self, s, s->mask|NET_WABLE); // corked, drain by poll
+        }
         return false;
     } else {
         _close_socket(self, s);
@@ -220,11 +270,28 @@ net_error(struct net* self, int err) {
     }
 }
 
+int
+net_poller(struct net* self) {
+    return np_poller(&self->np);
+}
+
 int 
 net_max_socket(struct net* self) {
     return self->max;
 }
 
+int64_t
+net_sendbytes(struct net* self) {
+    return self->wbuffersz;
+}
+
+int64_t
+net_readbytes(struct net* self, int64_t* cached) {
+    if (cached)
+        *cached = netbuf_cachedbytes(self->rpool);
+    return netbuf_usedbytes(self->rpool);
+}
+
 int
 net_subscribe(struct net* self, int id, bool read) {
     struct socket* s = _get_socket(self, id);
@@ -240,23 +307,37 @@ net_subscribe(struct net* self, int id, bool read) {
 }
 
 struct net*
-net_create(int max, int rbuffer) {
+net_create(int max, int rbuffer, int poller) {
     if (max == 0 || rbuffer == 0)
         return NULL;
 
     struct net* self = malloc(sizeof(struct net));
-    if (np_init(&self->np, max)) {
+    if (np_init(&self->np, max, poller)) {
         free(self);
         return NULL;
     }
     self->max = max;
     self->nevent = 0;
     self->ev = malloc(max * sizeof(struct np_event));
-    self->ne = malloc(max * sizeof(struct net_message));
+    self->necap = max + ACCEPT_BUDGET;
+    self->ne = malloc(self->necap * sizeof(struct net_message));
     self->sockets = _alloc_sockets(max);
     self->free_socket = &self->sockets[0];
     self->tail_socket = &self->sockets[max-1];
-    self->rpool = netbuf_create(max, rbuffer);
+    self->rpool = netbuf_create(rbuffer);
+    self->spool = sbuffer_pool_create(SBUFFER_CHUNK, SBUFFER_FREEMAX);
+    self->wbuffersz = 0;
+    self->corkmask = 0;
+    self->corkmax = INT_MAX;
+    self->corks = malloc(max * sizeof(int));
+    self->ncork = 0;
+    self->corkmsg = 0;
+    self->corkwrite = 0;
+    self->edge = (np_poller(&self->np) & NP_EDGE) != 0;
+    self->npoll = 0;
+    self->rqueue = malloc(max * sizeof(int));
+    self->nrqueue = 0;
+    self->requeued = 0;
     return self;
 }
 
@@ -277,7 +358,10 @@ net_free(struct net* self) {
     self->tail_socket = NULL;
     free(self->ev);
     free(self->ne);
+    free(self->corks);
+    free(self->rqueue);
     netbuf_free(self->rpool);
+    sbuffer_pool_free(self->spool);
 
     np_fini(&self->np);
     free(self);
@@ -291,6 +375,7 @@ _read_close(struct socket* s) {
         if (nbyte < 0) {
             int error = _socket_geterror(s->fd);
             if (error == SEAGAIN) {
+                s->rmore = false;
                 return 0;
             } else if (error == SEINTR) {
                 continue;
@@ -302,6 +387,7 @@ _read_close(struct socket* s) {
         } else {
             // if nbyte == sieof(buf) no need read more
             // next time read check, or write check 
+            s->rmore = nbyte == sizeof(buf);
             return 0;
         }
     }
@@ -325,6 +411,7 @@ _readto(struct net* self, struct socket* s, void* buf, int space, int* e) {
         if (nbyte < 0) {
             error = _socket_geterror(s->fd);
             if (error == SEAGAIN) {
+                s->rmore = false;
                 *e = 0;
                 return 0;
             } else if (error == SEINTR) {
@@ -341,6 +428,8 @@ _readto(struct net* self, struct socket* s, void* buf, int space, int* e) {
             *e = NET_ERR_EOF;
             return -1;
         } else {
+            // short read is drained, the new data trigger the edge again
+            s->rmore = nbyte == space;
             *e = 0;
             return nbyte;
         } 
@@ -356,12 +445,50 @@ net_readto(struct net* self, int id, void* buf, int space, int* e) {
     return -1; 
 }
 
+// the rb is empty, give it back, the next one shrink if the last read not fill
+static void
+_release_rb(struct net* self, struct socket* s) {
+    struct netbuf_block* rb = s->rb;
+    if (s->rfull)
+        s->rcls = rb->cls;
+    else
+        s->rcls = rb->cls > 0 ? rb->cls - 1 : 0;
+    netbuf_free_block(self->rpool, rb);
+    s->rb = NULL;
+}
+
+// make space for read, compact first, then grow to the next class
+static int
+_reserve_rb(struct net* self, struct socket* s) {
+    struct netbuf_block* rb = s->rb;
+    if (rb == NULL) {
+        s->rb = netbuf_alloc_block(self->rpool, s->rcls);
+        return 0;
+    }
+    if (RB_SPACE(rb) > 0)
+        return 0;
+    if (rb->rptr > 0) {
+        char* begin = RB_BASE(rb);
+        int off = rb->wptr - rb->rptr;
+        memmove(begin, begin + rb->rptr, off);
+        rb->rptr = 0;
+        rb->wptr = off;
+        return 0;
+    }
+    // the node link may carry the large message, see UM_LARGE
+    rb = netbuf_grow_block(self->rpool, rb, s->ut == NETUT_TRUST);
+    if (rb == NULL)
+        return 1; // one message large than the max class
+    s->rb = rb;
+    return 0;
+}
+
 int
 net_read(struct net* self, int id, bool force, struct mread_buffer* buf, int* e) {
     struct socket* s = _get_socket(self, id);
     if (s) {
         struct netbuf_block* rb = s->rb;
-        if (!force) {
+        if (!force && rb) {
             int nread = RB_NREAD(rb);
             if (nread > 0) {
                 buf->ptr = RB_RPTR(rb);
@@ -369,16 +496,28 @@ net_read(struct net* self, int id, bool force, struct mread_buffer* buf, int* e)
                 return buf->sz;
             }
         }
+        if (_reserve_rb(self, s)) {
+            _close_socket(self, s);
+            *e = NET_ERR_NOBUF;
+            return -1;
+        }
+        rb = s->rb;
         void* wptr = RB_WPTR(rb);
         int space  = RB_SPACE(rb);
-        //assert(space > 0);
         int nread = _readto(self, s, wptr, space, e);
         if (nread >= 0) {
+            s->rfull = nread == space;
             rb->wptr += nread;
             buf->ptr = RB_RPTR(rb);
             buf->sz = RB_NREAD(rb);
+            if (buf->sz == 0) {
+                _release_rb(self, s);
+            }
             return buf->sz;
         }
+        if (s->rb && RB_NREAD(s->rb) == 0) {
+            _release_rb(self, s);
+        }
     }
     return -1;
 }
@@ -390,31 +529,34 @@ net_dropread(struct net* self, int id, int sz) {
         return;
     }
     struct netbuf_block* rb = s->rb;
+    if (rb == NULL) {
+        return;
+    }
     rb->rptr += sz;
-    
-    if (rb->wptr == rb->sz) {
-        if (rb->rptr < rb->wptr) {
-            void* begin = rb+1;
-            int off = rb->wptr - rb->rptr;
-            memmove(begin, begin + rb->rptr, off);
-            rb->rptr = 0;
-            rb->wptr= off;
-        } else if (rb->rptr == rb->wptr) {
-            rb->rptr = 0;
-            rb->wptr = 0;
-        } else {
-            assert(0);
-        }
+    assert(rb->rptr <= rb->wptr);
+    if (rb->rptr == rb->wptr) {
+        _release_rb(self, s);
     }
 }
 
+// writev the queue chunks, drop the written bytes
 int
 _send_buffer(struct net* self, struct socket* s) {
+    struct iovec iov[SEND_IOV_MAX];
     int total = 0;
     while (s->head) {
         struct sbuffer* p = s->head;
+        int cnt = 0;
+        int sz = 0;
+        for (; p && cnt < SEND_IOV_MAX; p = p->next) {
+            iov[cnt].iov_base = SB_RPTR(p);
+            iov[cnt].iov_len  = SB_NREAD(p);
+            sz += SB_NREAD(p);
+            cnt++;
+        }
+        int nbyte;
         for (;;) {
-            int nbyte = _socket_write(s->fd, p->ptr, p->sz);
+            nbyte = _socket_writev(s->fd, iov, cnt);
             if (nbyte < 0) {
                 int error = _socket_geterror(s->fd);
                 if (error == SEAGAIN)
@@ -424,21 +566,36 @@ _send_buffer(struct net* self, struct socket* s) {
                 } else {
                     return error;
                 }
-            } else if (nbyte == 0) {
-                return 0;
-            } else if (nbyte < p->sz) {
-                p->ptr += nbyte;
-                p->sz -= nbyte;
-                s->wbuffersz -= nbyte;
-                return 0;
-            } else {
-                total += nbyte;
-                s->wbuffersz -= nbyte;
+            }
+            break;
+        }
+        if (nbyte == 0) {
+            return 0;
+        }
+        int partial = nbyte < sz; // kernel buffer full, wait writable
+        total += nbyte;
+        s->wbuffersz -= nbyte;
+        self->wbuffersz -= nbyte;
+        while (nbyte > 0) {
+            p = s->head;
+            int n = SB_NREAD(p);
+            if (nbyte < n) {
+                p->rptr += nbyte;
                 break;
             }
+            nbyte -= n;
+            s->head = p->next;
+            if (p->shared) {
+                s->wbuffersz -= SBUFFER_REFSZ;
+                self->wbuffersz -= SBUFFER_REFSZ;
+            }
+            sbuffer_free(self->spool, p);
+        }
+        if (s->head == NULL) {
+            s->tail = NULL;
+        } else if (partial) {
+            return 0;
         }
-        s->head = p->next;
-        free(p);
     }
     if (total > 0 &&
         s->head == NULL) {
@@ -447,8 +604,112 @@ _send_buffer(struct net* self, struct socket* s) {
     return 0;
 }
 
-int 
-net_send(struct net* self, int id, void* data, int sz, struct net_message* nm) {
+static inline void
+_push_buffer(struct socket* s, struct sbuffer* p) {
+    if (s->tail) {
+        assert(s->tail->next == NULL);
+        s->tail->next = p;
+    } else {
+        s->head = p;
+    }
+    s->tail = p;
+}
+
+// write the queue of cork socket, wait writable if not all write
+static int
+_flush_one(struct net* self, struct socket* s) {
+    int error = _send_buffer(self, s);
+    self->corkwrite++;
+    if (error == 0 && s->head) {
+        _subscribe(self, s, s->mask|NET_WABLE);
+    }
+    return error;
+}
+
+static int
+_send_error(struct net* self, struct socket* s, int error, struct net_message* nm) {
+    nm->fd = s->fd;
+    nm->connid = s - self->sockets;
+    nm->type = NETE_SOCKERR;
+    nm->error = NETERR(error);
+    nm->ud = s->ud;
+    nm->ut = s->ut;
+    _close_socket(self, s);
+    return 1;
+}
+
+// copy the unsent bytes to the tail chunks, skip the written bytes first
+static void
+_append_buffer(struct net* self, struct socket* s, const struct iovec* iov, int cnt, int skip) {
+    int i;
+    for (i=0; i<cnt; ++i) {
+        const char* data = iov[i].iov_base;
+        int sz = iov[i].iov_len;
+        if (skip >= sz) {
+            skip -= sz;
+            continue;
+        }
+        data += skip;
+        sz -= skip;
+        skip = 0;
+        while (sz > 0) {
+            struct sbuffer* p = s->tail;
+            if (p == NULL || SB_SPACE(p) <= 0) {
+                p = sbuffer_alloc(self->spool);
+                _push_buffer(s, p);
+            }
+            int n = SB_SPACE(p);
+            if (n > sz)
+                n = sz;
+            memcpy(SB_WPTR(p), data, n);
+            p->wptr += n;
+            data += n;
+            sz -= n;
+        }
+    }
+}
+
+static inline void
+_cork(struct net* self, struct socket* s) {
+    if (!s->corked) {
+        s->corked = true;
+        self->corks[self->ncork++] = s - self->sockets;
+    }
+}
+
+// the data of cork socket only queue, the queue is write once by net_flush,
+// or by poll if the socket is wait for writable
+static int
+_cork_sendv(struct net* self, struct socket* s, const struct iovec* iov, int cnt, int sz,
+        struct net_message* nm) {
+    s->wbuffersz += sz;
+    self->wbuffersz += sz;
+    if (s->wbuffersz > s->wbuffermax) {
+        return _send_error(self, s, NET_ERR_WBUFOVER, nm);
+    }
+    _append_buffer(self, s, iov, cnt, 0);
+    self->corkmsg++;
+    if (s->mask & NET_WABLE) {
+        return 0;
+    }
+    if (s->wbuffersz >= self->corkmax) {
+        int error = _flush_one(self, s);
+        if (error) {
+            return _send_error(self, s, error, nm);
+        }
+    } else {
+        _cork(self, s);
+    }
+    return 0;
+}
+
+int
+net_sendv(struct net* self, int id, const struct iovec* iov, int cnt, struct net_message* nm) {
+    int sz = 0;
+    int i;
+    for (i=0; i<cnt; ++i) {
+        sz += iov[i].iov_len;
+    }
     if (sz <= 0) {
         return -1;
     }
@@ -460,14 +721,16 @@ net_send(struct net* self, int id, void* data, int sz, struct net_message* nm) {
         return -1; // do not send
     }
     int error;
+    int n = 0;
+    if (s->cork) {
+        return _cork_sendv(self, s, iov, cnt, sz, nm);
+    }
     if (s->head == NULL) {
-        int n = _socket_write(s->fd, data, sz);
+        // queue empty, write the caller buffers directly
+        n = _socket_writev(s->fd, iov, cnt > SEND_IOV_MAX ? SEND_IOV_MAX : cnt);
         if (n >= sz) {
             return 0;
-        } else if (n >= 0) {
-            data = (char*)data + n;
-            sz -= n;
-        } else {
+        } else if (n < 0) {
             error = _socket_geterror(s->fd);
             switch (error) {
             case SEAGAIN:
@@ -477,58 +740,144 @@ net_send(struct net* self, int id, void* data, int sz, struct net_message* nm) {
             default:
                 goto errout;
             }
+            n = 0;
         }
-        s->wbuffersz += sz;
-        if (s->wbuffersz > s->wbuffermax) {
-            error = NET_ERR_WBUFOVER;
-            goto errout;
-        }
-        struct sbuffer* p = malloc(sizeof(*p) + sz);
-        memcpy(p->data, data, sz);
-        p->next = NULL;
-        p->sz = sz;
-        p->ptr = p->data;
-
-        s->head = s->tail = p;
+    }
+    s->wbuffersz += sz - n;
+    self->wbuffersz += sz - n;
+    if (s->wbuffersz > s->wbuffermax) {
+        error = NET_ERR_WBUFOVER;
+        goto errout;
+    }
+    bool empty = s->head == NULL;
+    _append_buffer(self, s, iov, cnt, n);
+    if (empty) {
         _subscribe(self, s, s->mask|NET_WABLE);
+    }
+    return 0;
+errout:
+    return _send_error(self, s, error, nm);
+}
+
+// one payload to many sockets, the sockets need buffer share one copy,
+// or copy to the tail chunk if it has space,
+// return the count of error message filled in nm (size n at least)
+int
+net_multicast(struct net* self, const int* ids, int n, void* data, int sz, struct net_message* nm) {
+    if (sz <= 0) {
         return 0;
-    } else {
-        s->wbuffersz += sz;
+    }
+    struct sbuffer_shared* shared = NULL;
+    int c = 0;
+    int i;
+    for (i=0; i<n; ++i) {
+        struct socket* s = _get_socket(self, ids[i]);
+        if (s == NULL ||
+            s->status == STATUS_HALFCLOSE) {
+            continue;
+        }
+        int error;
+        int off = 0;
+        if (s->head == NULL && !s->cork) {
+            off = _socket_write(s->fd, data, sz);
+            if (off >= sz) {
+                continue;
+            } else if (off < 0) {
+                error = _socket_geterror(s->fd);
+                if (error != SEAGAIN && error != SEINTR) {
+                    c += _send_error(self, s, error, &nm[c]);
+                    continue;
+                }
+                off = 0;
+            }
+        }
+        struct sbuffer* tail = s->tail;
+        bool copy = tail && tail->shared == NULL && SB_SPACE(tail) >= sz - off;
+        int bytes = copy ? sz - off : sz - off + SBUFFER_REFSZ;
+        s->wbuffersz += bytes;
+        self->wbuffersz += bytes;
         if (s->wbuffersz > s->wbuffermax) {
-            error = NET_ERR_WBUFOVER;
-            goto errout;
-        }
-        struct sbuffer* p = malloc(sizeof(*p) + sz);
-        memcpy(p->data, data, sz);
-        p->next = NULL;
-        p->sz = sz;
-        p->ptr = p->data;
-        assert(s->tail != NULL);
-        assert(s->tail->next == NULL);
-        s->tail->next = p;
-        s->tail = p;
-        return 0;
+            c += _send_error(self, s, NET_ERR_WBUFOVER, &nm[c]);
+            continue;
+        }
+        if (s->cork) {
+            self->corkmsg++;
+            if (!(s->mask & NET_WABLE)) {
+                _cork(self, s);
+            }
+        } else if (s->head == NULL) {
+            _subscribe(self, s, s->mask|NET_WABLE);
+        }
+        if (copy) {
+            memcpy(SB_WPTR(tail), (char*)data + off, sz - off);
+            tail->wptr += sz - off;
+            continue;
+        }
+        if (shared == NULL) {
+            shared = sbuffer_shared_create(data, sz);
+        }
+        _push_buffer(s, sbuffer_alloc_shared(shared, off));
     }
-errout:
-    nm->fd = s->fd;
-    nm->connid = s - self->sockets;
-    nm->type = NETE_SOCKERR;
-    nm->error = NETERR(error);
-    nm->ud = s->ud;
-    nm->ut = s->ut;
-    _close_socket(self, s);
-    return 1;
- 
+    return c;
+}
+
+// write the queue of the corked sockets, return the count of error message filled in nm,
+// stop if n message filled, the rest sockets keep in the list
+int
+net_flush(struct net* self, struct net_message* nm, int n) {
+    int c = 0;
+    int i = 0;
+    while (i < self->ncork && c < n) {
+        struct socket* s = &self->sockets[self->corks[i++]];
+        s->corked = false;
+        if (s->status == STATUS_INVALID ||
+            s->head == NULL ||
+            (s->mask & NET_WABLE)) {
+            continue;
+        }
+        int error = _flush_one(self, s);
+        if (error) {
+            c += _send_error(self, s, error, &nm[c]);
+        }
+    }
+    if (i < self->ncork) {
+        memmove(self->corks, self->corks + i, (self->ncork - i) * sizeof(int));
+    }
+    self->ncork -= i;
+    return c;
+}
+
+void
+net_cork(struct net* self, uint32_t utmask, int corkmax) {
+    self->corkmask = utmask;
+    self->corkmax = corkmax > 0 ? corkmax : INT_MAX;
+}
+
+void
+net_corkstat(struct net* self, int64_t* msgs, int64_t* writes) {
+    *msgs = self->corkmsg;
+    *writes = self->corkwrite;
+}
+
+int 
+net_send(struct net* self, int id, void* data, int sz, struct net_message* nm) {
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = sz > 0 ? sz : 0;
+    return net_sendv(self, id, &iov, 1, nm);
 }
    
+// NULL if fail, error 0 if no free socket and the connection is drop
 static inline struct socket*
-_accept(struct net* self, struct socket* listens) {
+_accept(struct net* self, struct socket* listens, int* error) {
     struct sockaddr_in remote_addr;
     socklen_t len = sizeof(remote_addr);
-    socket_t fd = accept(listens->fd, (struct sockaddr*)&remote_addr, &len);
+    socket_t fd = _socket_accept(listens->fd, (struct sockaddr*)&remote_addr, &len);
     if (fd < 0) {
+        *error = _socket_error;
         return NULL;
     }
+    *error = 0;
     uint32_t addr = remote_addr.sin_addr.s_addr;
     uint16_t port = ntohs(remote_addr.sin_port);
     struct socket* s = _create_socket(self, fd, addr, port, listens->wbuffermax, 
@@ -537,11 +886,6 @@ _accept(struct net* self, struct socket* listens) {
         _socket_close(fd);
         return NULL;
     }
-
-    if (_socket_nonblocking(fd) == -1) {
-        _close_socket(self, s);
-        return NULL;
-    }
     s->status = STATUS_CONNECTED;
     return s;
 }
@@ -596,6 +940,27 @@ net_listen(struct net* self, uint32_t addr, uint16_t port, int wbuffermax, int u
     return 0;
 }
 
+int
+net_attach(struct net* self, int fd, int ud, int ut) {
+    int error = 0;
+    if (_socket_nonblocking(fd) == -1) {
+        error = _socket_error;
+        return NETERR(error);
+    }
+    struct socket* s = _create_socket(self, fd, 0, 0, 0, ud, ut);
+    if (s == NULL) {
+        error = NET_ERR_CREATESOCK;
+        return NETERR(error);
+    }
+    if (_subscribe(self, s, NET_RABLE)) {
+        error = _socket_error;
+        _close_socket(self, s);
+        return NETERR(error);
+    }
+    s->status = STATUS_CONNECTED;
+    return 0;
+}
+
 static inline int
 _onconnect(struct net* self, struct socket* s) {
     int err;
@@ -697,87 +1062,201 @@ ok:
     return 1; // connected
 }
 
+static inline struct net_message*
+_event(struct net* self, struct socket* s, int type) {
+    struct net_message* oe = &self->ne[self->nevent++];
+    oe->fd = s->fd;
+    oe->connid = s - self->sockets;
+    oe->type = type;
+    oe->error = 0;
+    oe->ud = s->ud;
+    oe->ut = s->ut;
+    return oe;
+}
+
+static inline void
+_requeue(struct net* self, struct socket* s) {
+    if (!s->rqueued) {
+        s->rqueued = true;
+        self->rqueue[self->nrqueue++] = s - self->sockets;
+    }
+}
+
+// edge trigger read again until the reader get EAGAIN
+static inline void
+_read_event(struct net* self, struct socket* s) {
+    s->rpoll = self->npoll;
+    s->rmore = self->edge;
+    if (s->rmore) {
+        _requeue(self, s);
+    }
+}
+
+// accept until EAGAIN, the rest of the budget by the requeue,
+// the accept event is not more than necap
+static void
+_accept_all(struct net* self, struct socket* listens) {
+    int i;
+    if (listens->rwait) {
+        listens->rwait = false;
+        _subscribe(self, listens, NET_RABLE);
+    }
+    for (i=0; i<ACCEPT_BUDGET && self->nevent < self->necap; ++i) {
+        int error;
+        struct socket* s = _accept(self, listens, &error);
+        if (s) {
+            _event(self, s, NETE_ACCEPT);
+            continue;
+        }
+        if (error == 0 || error == SEINTR || error == ECONNABORTED) {
+            continue;
+        }
+        if (error == SEAGAIN) {
+            listens->rmore = false;
+            return;
+        }
+        // EMFILE, ENFILE, ENOBUFS: the backlog is not drained, retry at next poll,
+        // out of the poller until then, or the level trigger wake the poll at once
+        listens->rwait = true;
+        _subscribe(self, listens, 0);
+        break;
+    }
+    listens->rmore = true;
+    _requeue(self, listens);
+}
+
+static inline bool
+_requeue_need(struct socket* s) {
+    if (!s->rmore)
+        return false;
+    switch (s->status) {
+    case STATUS_LISTENING:
+        return true;
+    case STATUS_CONNECTED:
+    case STATUS_HALFCLOSE:
+        return (s->mask & NET_RABLE) != 0;
+    default:
+        return false;
+    }
+}
+
+// drop the drained socket, return the count to read again at once
+static int
+_requeue_check(struct net* self) {
+    int i, n = 0, c = 0;
+    for (i=0; i<self->nrqueue; ++i) {
+        int id = self->rqueue[i];
+        struct socket* s = &self->sockets[id];
+        if (_requeue_need(s)) {
+            self->rqueue[n++] = id;
+            if (!(s->status == STATUS_LISTENING && s->rwait))
+                c++;
+        } else {
+            s->rqueued = false;
+        }
+    }
+    self->nrqueue = n;
+    return c;
+}
+
+// the socket read by the poll event this time keep in queue, so do the rest
+// if the event is full, one socket requeue itself at most once,
+// so the list compact in place
+static void
+_requeue_poll(struct net* self) {
+    int n = self->nrqueue;
+    int i;
+    self->nrqueue = 0;
+    for (i=0; i<n; ++i) {
+        struct socket* s = &self->sockets[self->rqueue[i]];
+        s->rqueued = false;
+        if (!_requeue_need(s)) {
+            continue;
+        }
+        if (s->status == STATUS_LISTENING) {
+            _accept_all(self, s);
+        } else if (s->rpoll == self->npoll ||
+                   self->nevent >= self->necap) {
+            _requeue(self, s);
+        } else {
+            _event(self, s, NETE_READ);
+            _read_event(self, s);
+            self->requeued++;
+        }
+    }
+}
+
+void
+net_requeue(struct net* self, int id) {
+    struct socket* s = _get_socket(self, id);
+    if (s) {
+        s->rmore = true;
+        _requeue(self, s);
+    }
+}
+
+int64_t
+net_requeuestat(struct net* self) {
+    return self->requeued;
+}
+
 int
 net_poll(struct net* self, int timeout) {
     int i;
+    self->nevent = 0;
+    self->npoll++;
+    if (_requeue_check(self) > 0) {
+        timeout = 0;
+    }
     int n = np_poll(&self->np, self->ev, self->max, timeout);
-    int c = 0;
     for (i=0; i<n; ++i) {
         struct np_event* e = &self->ev[i];
         struct socket* s = e->ud;
-       
-        struct net_message* oe = &self->ne[i];
-        oe->type = NETE_INVALID;
-        oe->error = 0;
+        struct net_message* oe;
         switch (s->status) {
         case STATUS_LISTENING:
-            s = _accept(self, s);
-            if (s) {
-                oe->fd = s->fd;
-                oe->connid = s - self->sockets;
-                oe->type = NETE_ACCEPT;
-                oe->ud = s->ud;
-                oe->ut = s->ut;
-                c++;
-            }
+            // accept after the poll events, the count is bound by necap
+            s->rmore = true;
+            _requeue(self, s);
             break;
         case STATUS_CONNECTING:
             if (e->write) {
-                oe->fd = s->fd;
-                oe->connid = s - self->sockets;
-                oe->ud = s->ud;
-                oe->ut = s->ut;
+                oe = _event(self, s, NETE_CONNECT);
                 oe->error = _onconnect(self, s);
                 if (oe->error) {
                     oe->type = NETE_CONNERR;
-                } else {
-                    oe->type = NETE_CONNECT;
-                    if (e->read) {
-                        oe->type = NETE_CONN_THEN_READ;
-                    }
+                } else if (e->read) {
+                    oe->type = NETE_CONN_THEN_READ;
+                    _read_event(self, s);
                 }
-                c++;
             }
             break;
         case STATUS_CONNECTED:
         case STATUS_HALFCLOSE:
             if (e->write) {
-                oe->error = _send_buffer(self, s);
-                if (oe->error) {
-                    oe->fd = s->fd;
-                    oe->connid = s - self->sockets;
-                    oe->ud = s->ud;
-                    oe->ut = s->ut;
-                    oe->type = NETE_SOCKERR; 
-                    c++;
+                int error = _send_buffer(self, s);
+                if (error) {
+                    oe = _event(self, s, NETE_SOCKERR);
+                    oe->error = error;
                     _close_socket(self, s);
                     break;
                 }
                 if (s->status == STATUS_HALFCLOSE &&
                     s->head == NULL) {
-                    oe->fd = s->fd;
-                    oe->connid = s - self->sockets;
-                    oe->ud = s->ud;
-                    oe->ut = s->ut;
-                    oe->type = NETE_WRIDONECLOSE;
-                    c++;
+                    _event(self, s, NETE_WRIDONECLOSE);
                     _close_socket(self, s);
                     break;
                 }
             }
             if (e->read) {
-                oe->fd = s->fd;
-                oe->connid = s - self->sockets;
-                oe->ud = s->ud;
-                oe->ut = s->ut;
-                oe->type = NETE_READ;
-                c++;
+                _event(self, s, NETE_READ);
+                _read_event(self, s);
             }
             break;
         }
     }
-    self->nevent = c; 
-    return c;
+    _requeue_poll(self);
+    return self->nevent;
 }
 
 int
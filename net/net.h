@@ -4,6 +4,15 @@
 #include <stdint.h>
 #include "net_message.h"
 
+#ifndef WIN32
+#include <sys/uio.h>
+#else
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#endif
+
 // must be negative, positive for system error number
 //#define OK 0
 #define NET_ERR_EOF         -1
@@ -18,24 +27,43 @@ struct mread_buffer {
     int sz;
 };
 
+// poller of net_create
+#define NET_POLLER_EPOLL 0
+// or with the poller, epoll edge trigger, the reader must read until 0,
+// or call net_requeue if stop early, see net_poll
+#define NET_POLLER_EDGE  0x100
+
 struct net;
-struct net* net_create(int max, int rbuffer);
+struct net* net_create(int max, int rbuffer, int poller);
+int net_poller(struct net* self);
 void net_free(struct net* self);
 
 int net_listen(struct net* self, uint32_t addr, uint16_t port, int wbuffermax, int ud, int ut);
+int net_attach(struct net* self, int fd, int ud, int ut);
 int net_connect(struct net* self, uint32_t addr, uint16_t port, bool block, int wbuffermax, int ud, int ut, struct net_message* nm);
 int net_poll(struct net* self, int timeout);
 int net_getevents(struct net* self, struct net_message** e);
 int net_subscribe(struct net* self, int id, bool read);
+// read event again at next poll, the reader stop before the socket drained
+void net_requeue(struct net* self, int id);
+int64_t net_requeuestat(struct net* self);
 
 int net_readto(struct net* self, int id, void* buf, int space, int* e);
 int net_read(struct net* self, int id, bool force, struct mread_buffer* buf, int* e);
 void net_dropread(struct net* self, int id, int sz);
 
 int net_send(struct net* self, int id, void* data, int sz, struct net_message* nm);
+int net_sendv(struct net* self, int id, const struct iovec* iov, int cnt, struct net_message* nm);
+int net_multicast(struct net* self, const int* ids, int n, void* data, int sz, struct net_message* nm);
+// the socket of ut in utmask queue the send, write once by net_flush
+void net_cork(struct net* self, uint32_t utmask, int corkmax);
+int net_flush(struct net* self, struct net_message* nm, int n);
+void net_corkstat(struct net* self, int64_t* msgs, int64_t* writes);
 bool net_close_socket(struct net* self, int id, bool force);
 const char* net_error(struct net* self, int err);
 int net_max_socket(struct net* self);
+int64_t net_sendbytes(struct net* self);
+int64_t net_readbytes(struct net* self, int64_t* cached);
 int net_socket_address(struct net* self, int id, uint32_t* addr, uint16_t* port);
 int net_socket_isclosed(struct net* self, int id);
 
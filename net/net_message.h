@@ -17,6 +17,7 @@
 #define NETE_REDISREPLY 9
 
 #define NETUT_TRUST 0 // or UNTRUST
+#define NETUT_WAKEUP -2 // reactor mailbox wakeup
 
 struct net_message {
     int fd;
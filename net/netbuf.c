@@ -1,40 +1,153 @@
 #include "netbuf.h"
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
+#define CLASS_SMALL 512
+#define CLASS_MIDDLE 4096
+#define CACHE_BYTES (1024*1024) // of each class
+
+struct netbuf_class {
+    int size;
+    int ncache;
+    int maxcache;
+    struct netbuf_block* cache;
+};
+
 struct netbuf {
-    int max;
-    int block_size;
-    char blocks[0];
+    int nclass;
+    struct netbuf_class classes[NETBUF_CLASS_MAX];
+    int64_t usedbytes;
 };
 
 struct netbuf_block* 
-netbuf_alloc_block(struct netbuf* self, int id) {
-    assert(id >= 0 && id < self->max);
-    struct netbuf_block* buf_b =  (void*)self->blocks + id * self->block_size;
-    buf_b->sz = self->block_size - sizeof(*buf_b);
-    buf_b->rptr = 0;
-    buf_b->wptr = 0;
-    return buf_b;
+netbuf_alloc_block(struct netbuf* self, int cls) {
+    if (cls < 0)
+        cls = 0;
+    if (cls >= self->nclass)
+        cls = self->nclass - 1;
+    struct netbuf_class* c = &self->classes[cls];
+    struct netbuf_block* block = c->cache;
+    if (block) {
+        c->cache = block->next;
+        c->ncache--;
+    } else {
+        block = malloc(sizeof(*block) + c->size);
+        block->sz = c->size;
+        block->cls = cls;
+    }
+    block->rptr = 0;
+    block->wptr = 0;
+    block->next = NULL;
+    self->usedbytes += c->size;
+    return block;
 }
 
 void 
 netbuf_free_block(struct netbuf* self, struct netbuf_block* block) {
+    if (block == NULL)
+        return;
+    if (block->cls == NETBUF_CLASS_HUGE) {
+        self->usedbytes -= block->sz;
+        free(block);
+        return;
+    }
+    struct netbuf_class* c = &self->classes[block->cls];
+    self->usedbytes -= c->size;
+    if (c->ncache < c->maxcache) {
+        block->next = c->cache;
+        c->cache = block;
+        c->ncache++;
+    } else {
+        free(block);
+    }
+}
+
+static struct netbuf_block*
+_alloc_huge(struct netbuf* self, int sz) {
+    struct netbuf_block* block = malloc(sizeof(*block) + sz);
+    block->sz = sz;
+    block->cls = NETBUF_CLASS_HUGE;
     block->rptr = 0;
     block->wptr = 0;
+    block->next = NULL;
+    self->usedbytes += sz;
+    return block;
+}
+
+struct netbuf_block*
+netbuf_grow_block(struct netbuf* self, struct netbuf_block* block, bool huge) {
+    struct netbuf_block* nb;
+    if (block->cls + 1 < self->nclass) {
+        nb = netbuf_alloc_block(self, block->cls + 1);
+    } else if (huge && block->sz < NETBUF_HUGE_MAX) {
+        int sz = block->sz * 2;
+        nb = _alloc_huge(self, sz < NETBUF_HUGE_MAX ? sz : NETBUF_HUGE_MAX);
+    } else {
+        return NULL;
+    }
+    int n = RB_NREAD(block);
+    memcpy(RB_BASE(nb), RB_RPTR(block), n);
+    nb->wptr = n;
+    netbuf_free_block(self, block);
+    return nb;
+}
+
+int
+netbuf_maxclass(struct netbuf* self) {
+    return self->nclass - 1;
+}
+
+int64_t
+netbuf_usedbytes(struct netbuf* self) {
+    return self->usedbytes;
+}
+
+int64_t
+netbuf_cachedbytes(struct netbuf* self) {
+    int64_t bytes = 0;
+    int i;
+    for (i=0; i<self->nclass; ++i) {
+        bytes += (int64_t)self->classes[i].ncache * self->classes[i].size;
+    }
+    return bytes;
 }
 
 struct netbuf* 
-netbuf_create(int max, int block_size) {
-    if (max == 0 || block_size == 0)
+netbuf_create(int block_size) {
+    if (block_size <= 0)
         return NULL;
-    struct netbuf* nb = malloc(sizeof(struct netbuf) + max * block_size);
-    nb->max = max;
-    nb->block_size = block_size;
+    struct netbuf* nb = malloc(sizeof(*nb));
+    memset(nb, 0, sizeof(*nb));
+    int sizes[NETBUF_CLASS_MAX] = { CLASS_SMALL, CLASS_MIDDLE, block_size };
+    int i;
+    for (i=0; i<NETBUF_CLASS_MAX; ++i) {
+        int size = sizes[i];
+        if (size >= block_size)
+            size = block_size;
+        struct netbuf_class* c = &nb->classes[nb->nclass++];
+        c->size = size;
+        c->maxcache = CACHE_BYTES / size;
+        if (c->maxcache < 1)
+            c->maxcache = 1;
+        if (size == block_size)
+            break;
+    }
     return nb;
 }
 
 void 
 netbuf_free(struct netbuf* self) {
+    if (self == NULL)
+        return;
+    int i;
+    for (i=0; i<self->nclass; ++i) {
+        struct netbuf_block* block = self->classes[i].cache;
+        while (block) {
+            struct netbuf_block* next = block->next;
+            free(block);
+            block = next;
+        }
+    }
     free(self);
 }
@@ -2,24 +2,42 @@
 #define __NETBUF_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+
+// read buffer of size class, alloc when socket read, free when read over
+#define NETBUF_CLASS_MAX 3
+// over the max class, a huge block is alloc for one large message, not cached
+#define NETBUF_CLASS_HUGE NETBUF_CLASS_MAX
+#define NETBUF_HUGE_MAX (16*1024*1024+64)
 
 struct netbuf_block {
     int sz;
     int rptr;
     int wptr;
+    int cls; // size class
+    struct netbuf_block* next; // in the class cache
 };
 
-#define RB_RPTR(rb) ((char*)((rb)+1) + (rb)->rptr)
-#define RB_WPTR(rb) ((char*)((rb)+1) + (rb)->wptr)
+#define RB_BASE(rb) ((char*)((rb)+1))
+#define RB_RPTR(rb) (RB_BASE(rb) + (rb)->rptr)
+#define RB_WPTR(rb) (RB_BASE(rb) + (rb)->wptr)
 #define RB_SPACE(rb) ((rb)->sz   - (rb)->wptr)
 #define RB_NREAD(rb) ((rb)->wptr - (rb)->rptr)
 
 struct netbuf;
 
-struct netbuf_block* netbuf_alloc_block(struct netbuf* self, int id);
+struct netbuf_block* netbuf_alloc_block(struct netbuf* self, int cls);
+// move the unread data to a block of next class, NULL if the max class,
+// or a double size huge block if huge, NULL if NETBUF_HUGE_MAX
+struct netbuf_block* netbuf_grow_block(struct netbuf* self, struct netbuf_block* block, bool huge);
 void netbuf_free_block(struct netbuf* self, struct netbuf_block* block);
+int  netbuf_maxclass(struct netbuf* self);
+// bytes of the blocks alloc to socket, and in the cache
+int64_t netbuf_usedbytes(struct netbuf* self);
+int64_t netbuf_cachedbytes(struct netbuf* self);
 
-struct netbuf* netbuf_create(int max, int block_size);
+// block_size is the size of max class
+struct netbuf* netbuf_create(int block_size);
 void netbuf_free(struct netbuf* self);
 
 #endif
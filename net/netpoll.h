@@ -6,6 +6,12 @@
 #define NET_RABLE 1
 #define NET_WABLE 2
 
+// poller, the platform default if not support, same as NET_POLLER_*
+#define NP_DEFAULT 0
+#define NP_EPOLL   0
+// or with the poller, edge trigger, epoll only
+#define NP_EDGE    0x100
+
 struct np_event {
     void* ud;
     bool read;
@@ -13,12 +19,13 @@ struct np_event {
 };
 
 struct np_state;
-static int np_init(struct np_state* np, int max);
+static int np_init(struct np_state* np, int max, int poller);
 static void np_fini(struct np_state* np);
 static int np_add(struct np_state* np, int fd, int mask, void* ud);
 static int np_mod(struct np_state* np, int fd, int mask, void* ud); 
 static int np_del(struct np_state* np, int fd); 
 static int np_poll(struct np_state* np, struct np_event* e, int max, int timeout);
+static int np_poller(struct np_state* np);
     
 #ifdef __linux__
 #include "socket_epoll.h"
@@ -0,0 +1,96 @@
+#include "sbuffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+struct sbuffer_pool {
+    int chunk_size;
+    int maxfree;
+    int nfree;
+    struct sbuffer* free;
+};
+
+struct sbuffer*
+sbuffer_alloc(struct sbuffer_pool* self) {
+    struct sbuffer* sb = self->free;
+    if (sb) {
+        self->free = sb->next;
+        self->nfree--;
+    } else {
+        sb = malloc(self->chunk_size);
+    }
+    sb->sz = self->chunk_size - sizeof(*sb);
+    sb->shared = NULL;
+    sb->next = NULL;
+    sb->rptr = 0;
+    sb->wptr = 0;
+    return sb;
+}
+
+void
+sbuffer_free(struct sbuffer_pool* self, struct sbuffer* sb) {
+    if (sb->shared) {
+        sbuffer_shared_release(sb->shared);
+        free(sb);
+        return;
+    }
+    if (self->nfree >= self->maxfree) {
+        free(sb);
+        return;
+    }
+    sb->next = self->free;
+    self->free = sb;
+    self->nfree++;
+}
+
+struct sbuffer_shared*
+sbuffer_shared_create(const void* data, int sz) {
+    struct sbuffer_shared* shared = malloc(sizeof(*shared) + sz);
+    shared->ref = 0;
+    shared->sz = sz;
+    memcpy(shared+1, data, sz);
+    return shared;
+}
+
+struct sbuffer*
+sbuffer_alloc_shared(struct sbuffer_shared* shared, int offset) {
+    assert(offset >= 0 && offset < shared->sz);
+    struct sbuffer* sb = malloc(sizeof(*sb));
+    sb->next = NULL;
+    sb->shared = shared;
+    sb->sz = shared->sz;
+    sb->rptr = offset;
+    sb->wptr = shared->sz;
+    shared->ref++;
+    return sb;
+}
+
+void
+sbuffer_shared_release(struct sbuffer_shared* shared) {
+    if (--shared->ref <= 0) {
+        free(shared);
+    }
+}
+
+struct sbuffer_pool*
+sbuffer_pool_create(int chunk_size, int maxfree) {
+    assert(chunk_size > sizeof(struct sbuffer));
+    struct sbuffer_pool* self = malloc(sizeof(*self));
+    self->chunk_size = chunk_size;
+    self->maxfree = maxfree;
+    self->nfree = 0;
+    self->free = NULL;
+    return self;
+}
+
+void
+sbuffer_pool_free(struct sbuffer_pool* self) {
+    if (self == NULL)
+        return;
+    struct sbuffer* sb;
+    while ((sb = self->free)) {
+        self->free = sb->next;
+        free(sb);
+    }
+    free(self);
+}
@@ -0,0 +1,38 @@
+#ifndef __SBUFFER_H__
+#define __SBUFFER_H__
+
+// payload shared by many send queues, free when the last chunk drop it
+struct sbuffer_shared {
+    int ref;
+    int sz;
+};
+
+// fixed size chunk of the send queue, data in [rptr, wptr),
+// or a small node refer to a shared payload (no space to append, not pooled)
+struct sbuffer {
+    struct sbuffer* next;
+    int sz;
+    int rptr;
+    int wptr;
+    struct sbuffer_shared* shared;
+};
+
+#define SB_DATA(sb) ((sb)->shared ? (char*)((sb)->shared+1) : (char*)((sb)+1))
+#define SB_RPTR(sb) (SB_DATA(sb) + (sb)->rptr)
+#define SB_WPTR(sb) (SB_DATA(sb) + (sb)->wptr)
+#define SB_SPACE(sb) ((sb)->sz   - (sb)->wptr)
+#define SB_NREAD(sb) ((sb)->wptr - (sb)->rptr)
+
+struct sbuffer_pool;
+
+struct sbuffer* sbuffer_alloc(struct sbuffer_pool* self);
+void sbuffer_free(struct sbuffer_pool* self, struct sbuffer* sb);
+
+struct sbuffer_shared* sbuffer_shared_create(const void* data, int sz);
+struct sbuffer* sbuffer_alloc_shared(struct sbuffer_shared* shared, int offset);
+void sbuffer_shared_release(struct sbuffer_shared* shared);
+
+struct sbuffer_pool* sbuffer_pool_create(int chunk_size, int maxfree);
+void sbuffer_pool_free(struct sbuffer_pool* self);
+
+#endif
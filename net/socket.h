@@ -13,6 +13,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/uio.h>
 #endif
 
 // socket type
@@ -43,12 +44,14 @@
 #define _socket_geterror(fd) errno
 #define _socket_write(fd, buf, sz) write(fd, buf, sz)
 #define _socket_read(fd, buf, sz)  read(fd, buf, sz)
+#define _socket_writev(fd, iov, cnt) writev(fd, iov, cnt)
 #else
 #define _socket_error WSAGetLastError()
 #define _socket_strerror(e) "socket error"
 static inline int _socket_geterror(socket_t fd);
 #define _socket_write(fd, buf, sz) send(fd, buf, sz, 0)
 #define _socket_read(fd, buf, sz)  recv(fd, buf, sz, 0)
+static inline int _socket_writev(socket_t fd, const struct iovec* iov, int cnt);
 #endif
 
 // util function
@@ -74,6 +77,22 @@ _socket_closeonexec(socket_t fd) {
     return fcntl(fd, F_SETFL, flag | FD_CLOEXEC);
 }
 
+// accept the non-blocking, close-on-exec socket, one syscall by accept4
+static inline socket_t
+_socket_accept(socket_t fd, struct sockaddr* addr, socklen_t* len) {
+#if defined(__linux__) && defined(_GNU_SOURCE)
+    return accept4(fd, addr, len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    socket_t c = accept(fd, addr, len);
+    if (c >= 0 &&
+        (_socket_nonblocking(c) == -1 || _socket_closeonexec(c) == -1)) {
+        _socket_close(c);
+        return -1;
+    }
+    return c;
+#endif
+}
+
 static inline int
 _socket_reuseaddr(socket_t fd) {
     int reuse = 1;
@@ -99,11 +118,37 @@ _socket_closeonexec(socket_t fd) {
     return 0;
 }
 
+static inline socket_t
+_socket_accept(socket_t fd, struct sockaddr* addr, socklen_t* len) {
+    socket_t c = accept(fd, addr, len);
+    if (c != INVALID_SOCKET && _socket_nonblocking(c) == -1) {
+        _socket_close(c);
+        return INVALID_SOCKET;
+    }
+    return c;
+}
+
 static inline int
 _socket_reuseaddr(socket_t fd) {
     return 0;
 }
 
+// no writev, send one by one until would block
+static inline int
+_socket_writev(socket_t fd, const struct iovec* iov, int cnt) {
+    int total = 0;
+    int i;
+    for (i=0; i<cnt; ++i) {
+        int n = send(fd, iov[i].iov_base, iov[i].iov_len, 0);
+        if (n < 0)
+            return total > 0 ? total : n;
+        total += n;
+        if (n < (int)iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+
 static inline int
 _socket_geterror(socket_t fd) {
     int optval;
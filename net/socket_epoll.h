@@ -6,17 +6,22 @@
 
 struct np_state {
     int epoll_fd;
+    int et; // EPOLLET if NP_EDGE
     struct epoll_event* ev;
 };
 
 static int
-np_init(struct np_state* np, int max) {
+np_init(struct np_state* np, int max, int poller) {
+    np->epoll_fd = -1;
+    np->ev = NULL;
+    np->et = 0;
     int epoll_fd = epoll_create(max+1);
     if (epoll_fd == -1)
         return 1;
     if (_socket_closeonexec(epoll_fd))
         return 1;
     np->epoll_fd = epoll_fd;
+    np->et = (poller & NP_EDGE) ? EPOLLET : 0;
     np->ev = malloc(sizeof(struct epoll_event) * max);
     return 0;
 }
@@ -34,23 +39,23 @@ np_fini(struct np_state* np) {
 }
 
 static inline int
-_op(int epoll_fd, int fd, int op, int mask, void* ud) {
+_op(struct np_state* np, int fd, int op, int mask, void* ud) {
     struct epoll_event e;
-    e.events = 0;
+    e.events = np->et;
     if (mask & NET_RABLE) e.events |= EPOLLIN;
     if (mask & NET_WABLE) e.events |= EPOLLOUT;
     e.data.ptr = ud;
-    return epoll_ctl(epoll_fd, op, fd, &e);
+    return epoll_ctl(np->epoll_fd, op, fd, &e);
 }
 
 static int
 np_add(struct np_state* np, int fd, int mask, void* ud) {
-    return _op(np->epoll_fd, fd, EPOLL_CTL_ADD, mask, ud);
+    return _op(np, fd, EPOLL_CTL_ADD, mask, ud);
 }
 
 static int
 np_mod(struct np_state* np, int fd, int mask, void* ud) {
-    return _op(np->epoll_fd, fd, EPOLL_CTL_MOD, mask, ud);
+    return _op(np, fd, EPOLL_CTL_MOD, mask, ud);
 }
 
 static int
@@ -61,6 +66,11 @@ np_del(struct np_state* np, int fd) {
     return epoll_ctl(np->epoll_fd, EPOLL_CTL_DEL, fd, &e);
 }
 
+static inline int
+np_poller(struct np_state* np) {
+    return np->et ? (NP_EPOLL|NP_EDGE) : NP_EPOLL;
+}
+
 static int
 np_poll(struct np_state* np, struct np_event* e, int max, int timeout) {
     struct epoll_event* ev = np->ev;
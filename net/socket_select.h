@@ -18,7 +18,7 @@ struct np_state {
 };
 
 static int
-np_init(struct np_state* np, int max) {
+np_init(struct np_state* np, int max, int poller) {
     int cap = 1;
     while (cap < max)
         cap *= 2;
@@ -132,6 +132,11 @@ np_del(struct np_state* np, int fd) {
     return 0;
 }
 
+static int
+np_poller(struct np_state* np) {
+    return NP_DEFAULT;
+}
+
 static int
 np_poll(struct np_state* np, struct np_event* e, int max, int timeout) {
     if (np->maxfd == -1)
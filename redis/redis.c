@@ -357,11 +357,10 @@ redis_resetreply(struct redis_reply* reply) {
         }
         break;
     case REDIS_NEXTTIME:
-        // if pos_last == 0, then reader buf is no enough for one reply
-        assert(reader->pos_last > 0);
+        // if pos_last == 0, the reply start at the head, keep all and parse again
         assert(reader->pos_last <= reader->sz);
         reader->sz = reader->sz - reader->pos_last;
-        if (reader->sz > 0) {
+        if (reader->sz > 0 && reader->pos_last > 0) {
             memmove(reader->buf, 
                     reader->buf + reader->pos_last, 
                     reader->sz);
@@ -378,6 +377,19 @@ redis_resetreply(struct redis_reply* reply) {
     reply->stack[0] = root; 
 }
 
+int
+redis_growreplybuf(struct redis_reply* reply, int max) {
+    struct redis_reader* reader = &reply->reader;
+    if (!reader->my || reader->cap >= max)
+        return 1;
+    int cap = reader->cap * 2;
+    if (cap > max)
+        cap = max;
+    reader->buf = realloc(reader->buf, cap);
+    reader->cap = cap;
+    return 0;
+}
+
 void 
 redis_resetreplybuf(struct redis_reply* reply, char* buf, int sz) {
     struct redis_reader* reader = &reply->reader;
@@ -392,6 +404,117 @@ redis_resetreplybuf(struct redis_reply* reply, char* buf, int sz) {
     reply->stack[0] = root; 
 }
 
+/*
+ * request scanner
+ */
+static int
+_scan_line(const char* ptr, int sz) {
+    const char* end = memchr(ptr, '\n', sz);
+    if (end == NULL || end == ptr || end[-1] != '\r')
+        return -1;
+    return end - ptr + 1;
+}
+
+static int
+_scan_int(const char* ptr, int len, int* value) {
+    int i, v = 0;
+    if (len <= 0)
+        return -1;
+    for (i=0; i<len; ++i) {
+        if (ptr[i] < '0' || ptr[i] > '9')
+            return -1;
+        v = v*10 + (ptr[i] - '0');
+    }
+    *value = v;
+    return 0;
+}
+
+// return the size of one multibulk command
+static int
+_scan_multibulk(const char* ptr, int sz, const char** key, int* keysz) {
+    int pos = 0;
+    int len = _scan_line(ptr, sz);
+    int n;
+    if (len < 0 || _scan_int(ptr+1, len-3, &n) || n <= 0)
+        return -1;
+    pos += len;
+    int i;
+    for (i=0; i<n; ++i) {
+        if (pos >= sz || ptr[pos] != '$')
+            return -1;
+        int bulk;
+        len = _scan_line(ptr+pos, sz-pos);
+        if (len < 0 || _scan_int(ptr+pos+1, len-3, &bulk))
+            return -1;
+        pos += len;
+        if (pos + bulk + 2 > sz ||
+            ptr[pos+bulk] != '\r' || ptr[pos+bulk+1] != '\n')
+            return -1;
+        if (i == 0 || i == 1) {
+            *key = ptr+pos;
+            *keysz = bulk;
+        }
+        pos += bulk + 2;
+    }
+    return pos;
+}
+
+// return the size of one inline command
+static int
+_scan_inline(const char* ptr, int sz, const char** key, int* keysz) {
+    int len = _scan_line(ptr, sz);
+    if (len < 0)
+        return -1;
+    const char* end = ptr + len - 2;
+    const char* p = ptr;
+    int i;
+    for (i=0; i<2; ++i) {
+        while (p < end && *p == ' ') p++;
+        const char* tok = p;
+        while (p < end && *p != ' ') p++;
+        if (p > tok) {
+            *key = tok;
+            *keysz = p - tok;
+        }
+    }
+    return len;
+}
+
+int
+redis_scancommand(const char* ptr, int sz, const char** key, int* keysz) {
+    *key = NULL;
+    *keysz = 0;
+    if (sz <= 0)
+        return -1;
+    if (ptr[0] == '*') {
+        return _scan_multibulk(ptr, sz, key, keysz);
+    } else {
+        return _scan_inline(ptr, sz, key, keysz);
+    }
+}
+
+int
+redis_scanrequest(const char* ptr, int sz, const char** key, int* keysz) {
+    int n = 0;
+    int pos = 0;
+    *key = NULL;
+    *keysz = 0;
+    while (pos < sz) {
+        const char* k;
+        int ksz;
+        int len = redis_scancommand(ptr+pos, sz-pos, &k, &ksz);
+        if (len < 0)
+            return -1;
+        if (n == 0) {
+            *key = k;
+            *keysz = ksz;
+        }
+        pos += len;
+        n++;
+    }
+    return n;
+}
+
 /*
  * dump
  */
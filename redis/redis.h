@@ -68,9 +68,18 @@ int  redis_initreply(struct redis_reply* reply, int max, int bufcap);
 void redis_finireply(struct redis_reply* reply);
 void redis_resetreply(struct redis_reply* reply);
 void redis_resetreplybuf(struct redis_reply* reply, char* buf, int cap);
+// double the own buffer up to max, call after redis_resetreply, 0 if grown
+int  redis_growreplybuf(struct redis_reply* reply, int max);
 
 void redis_walkreply(struct redis_reply* reply);
 
+// scan the request, inline command or multibulk, 
+// return the command count, -1 if not complete or invalid,
+// key point to the first argument of the first command (or the command name)
+int  redis_scanrequest(const char* ptr, int sz, const char** key, int* keysz);
+// scan one command, return the size of it, -1 if not complete or invalid
+int  redis_scancommand(const char* ptr, int sz, const char** key, int* keysz);
+
 static inline int
 redis_bulkitem_isnull(struct redis_replyitem* item) {
     return item->value.len <= 0;
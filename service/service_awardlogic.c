@@ -84,11 +84,11 @@ static void
 _award(struct awardlogic* self, 
        int8_t type, struct player* p, const struct memberaward* award) {
     struct chardata* cdata = &p->data;
-    bool updated = false;
+    int dirty = 0;
     // coin
     if (award->coin > 0) {
         cdata->coin += award->coin;
-        updated = true;
+        dirty |= PD_COIN;
     }
     // exp
     int old_grade = 0, new_grade = 0;
@@ -100,7 +100,7 @@ _award(struct awardlogic* self,
             old_grade = _player_gradeid(old_level);
             new_grade = _player_gradeid(cdata->level);
         }
-        updated = true;
+        dirty |= PD_EXP;
     }
     // score
     switch (type) {
@@ -111,12 +111,12 @@ _award(struct awardlogic* self,
             _player_gradestr(new_grade), 
             _player_gradestr(old_grade),
             _get_score(cdata, cdata->score_normal));
-            updated = true;
+            dirty |= PD_EXP;
         } else if (award->score > cdata->score_normal) {
             cdata->score_normal = award->score;
             _rank(self, p, _player_gradestr(new_grade), "",
             _get_score(cdata, cdata->score_normal));
-            updated = true;
+            dirty |= PD_EXP;
         }
         break;
     case ROOM_TYPE_DASHI:
@@ -124,12 +124,12 @@ _award(struct awardlogic* self,
             cdata->score_dashi += award->score;
             _rank(self, p, "dashi", "", 
             _get_score(cdata, cdata->score_dashi));
-            updated = true;
+            dirty |= PD_EXP;
         }
         break;
     }
-    if (updated) {
-        send_playerdb(self->db_handler, p, PDB_SAVE);
+    if (dirty) {
+        _dirtyplayer(p, dirty);
     }
 }
 
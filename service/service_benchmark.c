@@ -32,6 +32,7 @@ struct benchmark {
     int query_done;
     int packetsz;
     int packetsplit;
+    int budget;
     uint64_t start;
     uint64_t end; 
 };
@@ -134,7 +135,10 @@ benchmark_init(struct service* s) {
         sz = sizeof(struct UM_BASE);
     self->packetsz = sz;
     self->packetsplit = sc_getint("benchmark_packet_split", 0);
-    int hmax = sc_getint("sc_connmax", 0);
+    self->budget = sc_getint("benchmark_read_budget", 10);
+    if (self->budget < 1)
+        self->budget = 1;
+    int hmax = sc_net_max_socket();
     int cmax = sc_getint("benchmark_client_max", 0); 
     
     self->max = cmax;
@@ -205,7 +209,7 @@ _read(struct benchmark* self, struct net_message* nm) {
             msg->nodeid = 0;
             memcpy(&msg->cli_base, one, UM_CLI_SZ(one));
             _handlemsg(self, c, msg);
-            if (++step > 10) {
+            if (++step >= self->budget) {
                 sc_net_dropread(id, nread-buf.sz);
                 return;
             }
@@ -139,7 +139,7 @@ _handleredisproxy(struct benchmarkdb* self, struct node_message* nm) {
     hassertlog(nm->um->msgid == IDUM_REDISREPLY);
     UM_CAST(UM_REDISREPLY, rep, nm->um);
     struct memrw rw;
-    memrw_init(&rw, rep->data, rep->msgsz - sizeof(*rep));
+    memrw_init(&rw, rep->data, nm->sz - sizeof(*rep));
 
     redis_resetreplybuf(&self->reply, rw.ptr, RW_SPACE(&rw));
     hassertlog(redis_getreply(&self->reply) == REDIS_SUCCEED);
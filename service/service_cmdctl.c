@@ -9,6 +9,8 @@
 #include "sc_node.h"
 #include "sc_reload.h"
 #include "sc_gate.h"
+#include "sc_net.h"
+#include "sc_profile.h"
 #include "node_type.h"
 #include "user_message.h"
 #include "args.h"
@@ -64,6 +66,14 @@ _setloglevel(struct cmdctl* self, struct args* A, struct memrw* rw) {
     return CTL_OK;
 }
 
+static int
+_logstat(struct cmdctl* self, struct args* A, struct memrw* rw) {
+    int n = snprintf(rw->ptr, RW_SPACE(rw), "[level %s, dropped %llu]",
+            sc_log_levelstr(sc_log_level()), (unsigned long long)sc_log_dropped());
+    memrw_pos(rw, n);
+    return CTL_OK;
+}
+
 static int
 _reload(struct cmdctl* self, struct args* A, struct memrw* rw) {
     if (A->argc <= 1)
@@ -157,11 +167,72 @@ _db(struct cmdctl* self, struct args* A, struct memrw* rw) {
     return CTL_OK;
 }
 
+static int
+_redisstat(struct cmdctl* self, struct args* A, struct memrw* rw) {
+    int handler = service_query_id("redisproxy");
+    if (handler == SERVICE_INVALID) {
+        return CTL_NOSERVICE;
+    }
+    struct service_message sm = {0, 0, sc_cstr_to_int32("STAT"), 0, NULL, rw};
+    service_notify_service(handler, &sm);
+    return CTL_OK;
+}
+
+// stats [reset]
+static int
+_stats(struct cmdctl* self, struct args* A, struct memrw* rw) {
+    if (A->argc > 1) {
+        if (strcmp(A->argv[1], "reset"))
+            return CTL_ARGINVALID;
+        sc_profile_reset();
+        return CTL_OK;
+    }
+    int n = sc_profile_dump(rw->ptr, RW_SPACE(rw));
+    memrw_pos(rw, n);
+    return CTL_OK;
+}
+
+// msgstat [reset]
+static int
+_msgstat(struct cmdctl* self, struct args* A, struct memrw* rw) {
+    int handler = service_query_id("dispatcher");
+    if (handler == SERVICE_INVALID) {
+        return CTL_NOSERVICE;
+    }
+    int type = sc_cstr_to_int32("MSTA");
+    if (A->argc > 1) {
+        if (strcmp(A->argv[1], "reset"))
+            return CTL_ARGINVALID;
+        type = sc_cstr_to_int32("MRST");
+    }
+    struct service_message sm = {0, 0, type, 0, NULL, rw};
+    service_notify_service(handler, &sm);
+    return CTL_OK;
+}
+
+static int
+_netstat(struct cmdctl* self, struct args* A, struct memrw* rw) {
+    int64_t cached = 0;
+    int64_t rbytes = sc_net_readbytes(&cached);
+    int64_t wbytes = sc_net_sendbytes();
+    int64_t corkwrite = 0;
+    int64_t corkmsg = sc_net_corkstat(&corkwrite);
+    int64_t requeue = sc_net_requeuestat();
+    int n = snprintf(rw->ptr, RW_SPACE(rw), "[read buffer %lld, cached %lld, send buffer %lld, "
+            "cork msg %lld, write %lld, saved %lld, requeue read %lld]",
+            (long long)rbytes, (long long)cached, (long long)wbytes,
+            (long long)corkmsg, (long long)corkwrite, (long long)(corkmsg - corkwrite),
+            (long long)requeue);
+    memrw_pos(rw, n);
+    return CTL_OK;
+}
+
 ///////////////////
 
 static struct ctl_command COMMAND_MAP[] = {
     { "getloglevel", _getloglevel },
     { "setloglevel", _setloglevel },
+    { "logstat",     _logstat },
     { "reload",      _reload },
     { "shownode",    _shownode },
     { "stop",        _stop },
@@ -171,6 +242,10 @@ static struct ctl_command COMMAND_MAP[] = {
     { "players",     _players },
     { "reloadres",   _reloadres },
     { "db",          _db },
+    { "redisstat",   _redisstat },
+    { "netstat",     _netstat },
+    { "msgstat",     _msgstat },
+    { "stats",       _stats },
     { NULL, NULL },
 };
 
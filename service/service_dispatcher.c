@@ -1,14 +1,33 @@
 #include "sc_service.h"
 #include "sc_log.h"
+#include "sc_util.h"
 #include "message_reader.h"
 #include "message_helper.h"
 #include "user_message.h"
 #include "node_type.h"
+#include "memrw.h"
 #include <assert.h>
 #include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * msg stat, alloc when subscribe, handle time is bucket by log2 of
+ * microseconds, bucket i hold [2^(i-1), 2^i) us, the last one hold the rest
+ */
+#define TIME_BUCKET 16
+
+struct msgstat {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t time; // us
+    uint32_t hist[TIME_BUCKET];
+};
 
 struct dispatcher {
     int services[IDUM_MAX]; // hold for all subscriber(service id) of msg
+    struct msgstat* stats[IDUM_MAX];
+    uint64_t invalid; // msg of no subscriber
 };
 
 struct dispatcher*
@@ -17,7 +36,9 @@ dispatcher_create() {
     int i;
     for (i=0; i<IDUM_MAX; ++i) {
         self->services[i] = SERVICE_INVALID;
+        self->stats[i] = NULL;
     }
+    self->invalid = 0;
     return self;
 }
 
@@ -28,26 +49,117 @@ _locate_service(struct dispatcher* self, struct UM_BASE* um)  {
     if (msgid >= 0 && msgid < IDUM_MAX) {
         serviceid = self->services[msgid];
         if (serviceid != SERVICE_INVALID) {
-            sc_debug("Receive msg:%d, from %s, to service:%s", 
-                    msgid, 
-                    sc_node_typename(HNODE_TID(um->nodeid)), 
-                    service_query_name(serviceid));
+            if (sc_log_level() <= LOG_DEBUG) {
+                sc_debug("Receive msg:%d, from %s, to service:%s", 
+                        msgid, 
+                        sc_node_typename(HNODE_TID(um->nodeid)), 
+                        service_query_name(serviceid));
+            }
             return serviceid; } }
-    sc_debug("Receive invalid msg:%d, from %s", msgid,
-            sc_node_typename(HNODE_TID(um->nodeid)));
+    self->invalid++;
+    if (sc_log_level() <= LOG_DEBUG) {
+        sc_debug("Receive invalid msg:%d, from %s", msgid,
+                sc_node_typename(HNODE_TID(um->nodeid)));
+    }
     return SERVICE_INVALID;
 }
 
+static inline uint64_t
+_elapsed_us() {
+    struct timespec ti;
+    clock_gettime(CLOCK_MONOTONIC, &ti);
+    return (uint64_t)ti.tv_sec * 1000000 + ti.tv_nsec / 1000;
+}
+
+static inline void
+_stat(struct dispatcher* self, int msgid, int sz, uint64_t start) {
+    struct msgstat* st = self->stats[msgid];
+    if (st == NULL)
+        return;
+    uint64_t us = _elapsed_us() - start;
+    int b = 0;
+    while (b < TIME_BUCKET-1 && (us >> b) > 0)
+        b++;
+    st->count++;
+    st->bytes += sz;
+    st->time += us;
+    st->hist[b]++;
+}
+
 void
 dispatcher_free(struct dispatcher* self) {
     if (self == NULL)
         return;
+    int i;
+    for (i=0; i<IDUM_MAX; ++i) {
+        free(self->stats[i]);
+    }
     free(self);
 }
 
+static bool
+_write(struct memrw* rw, int n) {
+    if (n < 0 || n >= RW_SPACE(rw))
+        return false;
+    memrw_pos(rw, n);
+    return true;
+}
+
+// "MSTA": dump the msg stat to sm->result, one line one msgid
+static void
+_dumpstat(struct dispatcher* self, struct memrw* rw) {
+    if (!_write(rw, snprintf(rw->ptr, RW_SPACE(rw), "invalid %llu\n",
+                    (unsigned long long)self->invalid)))
+        return;
+    int i, b;
+    for (i=0; i<IDUM_MAX; ++i) {
+        struct msgstat* st = self->stats[i];
+        if (st == NULL || st->count == 0)
+            continue;
+        if (!_write(rw, snprintf(rw->ptr, RW_SPACE(rw),
+                        "msg %d [%s]: count %llu, bytes %llu, avg %lluus, hist",
+                        i, service_query_name(self->services[i]),
+                        (unsigned long long)st->count,
+                        (unsigned long long)st->bytes,
+                        (unsigned long long)(st->time / st->count))))
+            return;
+        for (b=0; b<TIME_BUCKET; ++b) {
+            if (st->hist[b] == 0)
+                continue;
+            if (!_write(rw, snprintf(rw->ptr, RW_SPACE(rw), " %s%dus:%u",
+                            b < TIME_BUCKET-1 ? "<" : ">=",
+                            b < TIME_BUCKET-1 ? (1<<b) : (1<<(b-1)),
+                            st->hist[b])))
+                return;
+        }
+        if (!_write(rw, snprintf(rw->ptr, RW_SPACE(rw), "\n")))
+            return;
+    }
+}
+
+// "MRST": reset the msg stat
+static void
+_resetstat(struct dispatcher* self) {
+    int i;
+    for (i=0; i<IDUM_MAX; ++i) {
+        if (self->stats[i]) {
+            memset(self->stats[i], 0, sizeof(struct msgstat));
+        }
+    }
+    self->invalid = 0;
+}
+
 void
 dispatcher_service(struct service* s, struct service_message* sm) {
     struct dispatcher* self = SERVICE_SELF;
+    if (sm->type == sc_cstr_to_int32("MSTA")) {
+        if (sm->result)
+            _dumpstat(self, sm->result);
+        return;
+    } else if (sm->type == sc_cstr_to_int32("MRST")) {
+        _resetstat(self);
+        return;
+    }
     int serviceid = sm->sessionid;
     int msgid = (int)(intptr_t)sm->msg;
 
@@ -55,6 +167,8 @@ dispatcher_service(struct service* s, struct service_message* sm) {
         int tmp = self->services[msgid];
         if (tmp == SERVICE_INVALID) {
             self->services[msgid] = serviceid; 
+            self->stats[msgid] = malloc(sizeof(struct msgstat));
+            memset(self->stats[msgid], 0, sizeof(struct msgstat));
         } else {
             sc_error("subscribe repeat (service:%s and %s) msgid:%d", 
                     service_query_name(tmp),
@@ -82,13 +196,21 @@ dispatcher_net(struct service* s, struct net_message* nm) {
             return;
         }
         struct UM_BASE* um;
-        while ((um = mread_one(&buf, &error))) {
+        int sz;
+        while ((um = mread_one(&buf, &sz, &error))) {
             int serviceid = _locate_service(self, um);
             if (serviceid != SERVICE_INVALID) {
-                service_notify_nodemsg(serviceid, id, um, um->msgsz);
+                int msgid = um->msgid;
+                uint64_t start = _elapsed_us();
+                service_notify_nodemsg(serviceid, id, um, sz);
+                _stat(self, msgid, sz, start);
+                if (sc_net_socket_isclosed(id)) {
+                    return; // closed by handler, the read buffer is gone
+                }
             }
             if (++step > 1000) {
                 sc_net_dropread(id, nread-buf.sz);
+                sc_net_requeue(id);
                 return;
             }
         }
@@ -108,6 +230,9 @@ dispatcher_usermsg(struct service* s, int id, void* msg, int sz) {
     struct node_message* nm = msg;
     int serviceid = _locate_service(self, nm->um);
     if (serviceid != SERVICE_INVALID) {
+        int msgid = nm->um->msgid, umsz = nm->sz;
+        uint64_t start = _elapsed_us();
         service_notify_usermsg(serviceid, id, msg, sz);
+        _stat(self, msgid, umsz, start);
     }
 }
@@ -5,6 +5,7 @@
 #include "sc_node.h"
 #include "sc_dispatcher.h"
 #include "user_message.h"
+#include "forward_batch.h"
 #include "cli_message.h"
 #include "node_type.h"
 #include "map.h"
@@ -24,6 +25,7 @@ struct accinfo {
 struct forward {
     uint32_t webaddr;
     struct idmap* regacc;
+    struct fwbatch batch; // to world
 };
 
 struct forward*
@@ -44,6 +46,7 @@ forward_free(struct forward* self) {
     if (self->regacc) {
         idmap_free(self->regacc, _freecb);
     }
+    fwbatch_fini(&self->batch);
     free(self);
 }
 
@@ -59,19 +62,16 @@ forward_init(struct service* s) {
     self->regacc = idmap_create(1); // memory
 
     SUBSCRIBE_MSG(s->serviceid, IDUM_FORWARD);
+    SUBSCRIBE_MSG(s->serviceid, IDUM_FORWARDV);
     sc_timer_register(s->serviceid, 1000);
     return 0;
 }
 
 static inline void
-_forward_world(struct gate_client* c, struct UM_BASE* um) {
-    UM_DEFVAR(UM_FORWARD, fw);
-    fw->cid = c->connid;
-    memcpy(&fw->wrap, um, um->msgsz);
-    fw->wrap.nodeid = sc_id();
+_forward_world(struct forward* self, struct gate_client* c, struct UM_BASE* um) {
     const struct sc_node* node = sc_node_get(HNODE_ID(NODE_WORLD, 0));
     if (node) {
-        UM_SEND(node->connid, fw, UM_FORWARD_size(fw));
+        fwbatch_sendwrap(&self->batch, node->connid, c->connid, um);
     }
 }
 
@@ -85,7 +85,7 @@ _logout(struct forward*self, struct gate_client* c, int error, bool forceclose,
         // logout from remote world
         UM_DEFFIX(UM_LOGOUT, logout);
         logout->error = error;
-        _forward_world(c, (struct UM_BASE*)logout);
+        _forward_world(self, c, (struct UM_BASE*)logout);
     }
     sc_gate_disconnclient(c, forceclose);
 }
@@ -140,7 +140,7 @@ forward_usermsg(struct service* s, int id, void* msg, int sz) {
                 return;
             }
         }
-        _forward_world(c, um);
+        _forward_world(self, c, um);
     } else {
         // todo: just disconnect it ?
         _logout(self, c, SERR_INVALIDMSG, true, true);
@@ -192,11 +192,7 @@ _handleload(struct forward* self, struct node_message* nm) {
 }
 
 static void
-_handledef(struct forward*self, struct node_message* nm) {
-    if (nm->um->msgid != IDUM_FORWARD) {
-        return;
-    }
-    UM_CAST(UM_FORWARD, fw, nm->um);
+_forwardtocli(struct forward* self, struct UM_FORWARD* fw) {
     struct UM_BASE* m = &fw->wrap;
     struct gate_client* c = sc_gate_getclient(fw->cid);
     if (c) {
@@ -210,6 +206,27 @@ _handledef(struct forward*self, struct node_message* nm) {
     }
 }
 
+static void
+_handledef(struct forward*self, struct node_message* nm) {
+    switch (nm->um->msgid) {
+    case IDUM_FORWARD: {
+        UM_CAST(UM_FORWARD, fw, nm->um);
+        _forwardtocli(self, fw);
+        break;
+        }
+    case IDUM_FORWARDV: {
+        UM_CAST(UM_FORWARDV, fv, nm->um);
+        struct UM_FORWARDV_iter it;
+        struct UM_FORWARD* fw;
+        UM_FORWARDV_begin(fv, &it);
+        while ((fw = UM_FORWARDV_next(&it))) {
+            _forwardtocli(self, fw);
+        }
+        break;
+        }
+    }
+}
+
 void
 forward_nodemsg(struct service* s, int id, void* msg, int sz) {
     struct forward* self = SERVICE_SELF;
@@ -241,21 +258,21 @@ forward_net(struct service* s, struct gate_message* gm) {
     }
 }
 
-static void
+static int
 _acctimecb(uint32_t key, void* value, void* ud) {
-    struct forward* self = ud;
     struct accinfo* acc = value;
-    uint64_t now = sc_timer_now();
+    uint64_t now = *(uint64_t*)ud;
     if (now > acc->regtime &&
         now - acc->regtime > 20*1000) {
-        // todo: optimize
-        void* rm = idmap_remove(self->regacc, key);
-        free(rm);
+        free(acc);
+        return 1;
     }
+    return 0;
 }
 
 void
 forward_time(struct service* s) {
     struct forward* self= SERVICE_SELF;
-    idmap_foreach(self->regacc, _acctimecb, self);
+    uint64_t now = sc_timer_now();
+    idmap_foreach_remove(self->regacc, _acctimecb, &now);
 }
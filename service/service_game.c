@@ -5,9 +5,12 @@
 #include "sc_timer.h"
 #include "sc_dispatcher.h"
 #include "sc_gate.h"
+#include "sc_env.h"
+#include "sc_net.h"
 #include "sharetype.h"
 #include "node_type.h"
 #include "gfreeid.h"
+#include "idlist.h"
 #include "cli_message.h"
 #include "user_message.h"
 #include "fight.h"
@@ -16,21 +19,31 @@
 #include "map.h"
 #include "roommap.h"
 #include "genmap.h"
+#include "genmap_pool.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
 #include <math.h>
+#include <limits.h>
 
 #define ENTER_TIMELEAST (ROOM_LOAD_TIMELEAST*1000)
 #define ENTER_TIMEOUT (5000+ENTER_TIMELEAST)
 #define START_TIMEOUT 3000
 #define DESTROY_TIMEOUT 500
 
+// the duration samples of game_time, for the load report
+#define TICK_SAMPLE 128
+
 #define RS_CREATE 0
 #define RS_ENTER  1
 #define RS_START  2
 #define RS_OVER   3
+#define RS_MAX    4
+
+// the room pool shrink check interval (game_time tick), and the min cap
+#define ROOM_SHRINK_TICK 60
+#define ROOM_POOL_MIN 64
 
 // refresh data type, binary bit
 #define REFRESH_SPEED 1 
@@ -68,11 +81,14 @@ struct room {
     uint32_t key;
     int status; // RS_*
     uint64_t statustime;
+    IDLIST_LINK; // of the status list
     uint64_t starttime;
     int np;
     struct member p[MEMBER_MAX];
     struct groundattri gattri;
-    struct genmap* map;
+    struct genmap* map; // mapitem->map
+    struct genmap_item* mapitem;
+    struct tplt* tplt; // the version at create, hold until destroy
 };
 
 struct gfroom {
@@ -81,14 +97,35 @@ struct gfroom {
 
 struct game {
     int tplt_handler;
+    struct genmap_pool* genpool;
+    int64_t gentimer; // poll the genpool while pending
+    int genseed; // map seed count of one map, 0 one seed per room
+    bool closing;
     int pmax;
     struct player* players;
     struct gfroom rooms;
-    int tick;
+    struct idlist status[RS_MAX]; // rooms of one status, in order of statustime
+    int shrink_tick;
     uint32_t randseed;
+    int report_interval; // second, the load report to world
+    int report_tick;
+    int nroom;
+    int ntick;
+    int ticks[TICK_SAMPLE]; // microsecond
+};
+
+// timer callback locate the member by roomid and charid, 
+// the room pool may realloc
+struct buff_owner {
+    struct game* self;
+    int roomid;
+    uint32_t charid;
+    uint32_t itemid;
+    int64_t timer;
 };
 
 struct buff_delay {
+    struct buff_owner owner;
     uint64_t effect_time;
     uint64_t last_time;
 };
@@ -102,6 +139,7 @@ struct buff_effect {
 #define BUFF_EFFECT 3
 
 struct buff {
+    struct buff_owner owner;
     struct buff_effect effects[BUFF_EFFECT];
     int time;
 };
@@ -151,18 +189,31 @@ game_create() {
 }
 
 static void
-_freecb(void* value) {
-    free(value);
+_free_delaycb(void* value) {
+    struct buff_delay* bdelay = value;
+    if (bdelay->owner.timer) {
+        sc_timer_del(bdelay->owner.timer);
+    }
+    free(bdelay);
+}
+
+static void
+_free_buffcb(void* value) {
+    struct buff* b = value;
+    if (b->owner.timer) {
+        sc_timer_del(b->owner.timer);
+    }
+    free(b);
 }
 
 static void
 _freemember(struct member* m) {
     if (m->delaymap) {
-        idmap_free(m->delaymap, _freecb);
+        idmap_free(m->delaymap, _free_delaycb);
         m->delaymap = NULL;
     }
     if (m->buffmap) {
-        idmap_free(m->buffmap, _freecb);
+        idmap_free(m->buffmap, _free_buffcb);
         m->buffmap = NULL;
     }
 }
@@ -171,6 +222,11 @@ void
 game_free(struct game* self) {
     if (self == NULL)
         return;
+    self->closing = true;
+    if (self->gentimer) {
+        sc_timer_del(self->gentimer);
+    }
+    genmap_pool_free(self->genpool);
     free(self->players);
 
     struct room* ro;
@@ -192,12 +248,8 @@ game_free(struct game* self) {
 }
 
 static inline struct item_tplt*
-_get_item_tplt(struct game* self, uint32_t itemid) {
-    const struct tplt_visitor* vist = tplt_get_visitor(TPLT_ITEM);
-    if (vist) {
-        return tplt_visitor_find(vist, itemid);
-    }
-    return NULL;
+_get_item_tplt(struct room* ro, uint32_t itemid) {
+    return tplt_vfind(ro->tplt, TPLT_ITEM, itemid);
 }
 
 int
@@ -215,13 +267,25 @@ game_init(struct service* s) {
     memset(self->players, 0, sizeof(struct player) * pmax);
     // todo test this
     GFREEID_INIT(room, &self->rooms, 1);
+    int i;
+    for (i=0; i<RS_MAX; ++i) {
+        IDLIST_INIT(&self->status[i]);
+    }
 
     self->randseed = time(NULL);
 
+    self->report_interval = sc_getint("game_load_report", 5);
+    // the rooms share the generated map only if the seed repeat
+    self->genseed = sc_getint("game_genmap_seed", 0);
+    if (self->genseed < 0)
+        self->genseed = 0;
+    self->genpool = genmap_pool_create(sc_getint("game_genmap_thread", 2), 
+            self->genseed > 0 ? sc_getint("game_genmap_cache", 64) : 0);
+
     SUBSCRIBE_MSG(s->serviceid, IDUM_CREATEROOM);
     SUBSCRIBE_MSG(s->serviceid, IDUM_CREATEROOMRES);
 
-    sc_timer_register(s->serviceid, 100);
+    sc_timer_register(s->serviceid, 1000);
     return 0;
 }
 
@@ -275,6 +339,25 @@ _getmember(struct room* ro, uint32_t charid) {
     }
     return NULL;
 }
+static inline void
+_init_owner(struct buff_owner* owner, struct game* self, struct room* ro, 
+        struct member* m, uint32_t itemid) {
+    owner->self = self;
+    owner->roomid = GFREEID_ID(ro, &self->rooms);
+    owner->charid = m->detail.charid;
+    owner->itemid = itemid;
+    owner->timer = 0;
+}
+
+static struct member*
+_owner_member(struct buff_owner* owner, struct room** ro) {
+    *ro = _getroom(owner->self, owner->roomid);
+    if (*ro == NULL)
+        return NULL;
+    struct member* m = _getmember(*ro, owner->charid);
+    return (m && m->online) ? m : NULL;
+}
+
 static int
 _count_onlinemember(struct room* ro) {
     struct member* m;
@@ -317,15 +400,20 @@ _elapsed(uint64_t t, uint64_t elapse) {
 
 static void
 _multicast_msg(struct room* ro, struct UM_BASE* um, uint32_t except) {
+    int ids[MEMBER_MAX];
+    int n = 0;
     struct member* m;
     int i;
     for (i=0; i<ro->np; ++i) {
         m = &ro->p[i];
         if (m->detail.charid != except &&
             m->online) {
-            UM_SENDTOCLI(m->connid, um, um->msgsz);
+            ids[n++] = m->connid;
         }
     }
+    if (n > 0) {
+        UM_MULTICASTTOCLI(ids, n, um, um->msgsz);
+    }
 }
 static void
 _logout(struct game* self, struct gate_client* c, bool disconn, bool multicast) {
@@ -362,26 +450,45 @@ _logout(struct game* self, struct gate_client* c, bool disconn, bool multicast)
 //////////////////////////////////////////////////////////////////////
 // room logic
 
+static inline struct room*
+_roomat(struct game* self, int id) {
+    return id >= 0 ? &self->rooms.p[id] : NULL;
+}
+static inline void
+_link_status(struct game* self, struct room* ro) {
+    IDLIST_PUSHBACK(&self->status[ro->status], self->rooms.p, GFREEID_ID(ro, &self->rooms));
+}
+static inline void
+_unlink_status(struct game* self, struct room* ro) {
+    IDLIST_REMOVE(&self->status[ro->status], self->rooms.p, GFREEID_ID(ro, &self->rooms));
+}
+// append to tail, statustime is now, so the list keep in order
+static void
+_set_status(struct game* self, struct room* ro, int status) {
+    _unlink_status(self, ro);
+    ro->status = status;
+    ro->statustime = sc_timer_now();
+    _link_status(self, ro);
+}
 static struct room*
 _create_room(struct game* self) {
     struct room* ro = GFREEID_ALLOC(room, &self->rooms);
     assert(ro);
     ro->status = RS_CREATE;
     ro->statustime = sc_timer_now();
+    _link_status(self, ro);
     return ro;
 }
 static void
-_enter_room(struct room* ro) {
-    ro->status = RS_ENTER;
-    ro->statustime = sc_timer_now();
+_enter_room(struct game* self, struct room* ro) {
+    _set_status(self, ro, RS_ENTER);
     UM_DEFFIX(UM_GAMEENTER, enter);
     _multicast_msg(ro, (void*)enter, 0);
 }
 static void
-_start_room(struct room* ro) {
-    ro->status = RS_START; 
-    ro->starttime = sc_timer_now();
-    ro->statustime = ro->starttime;
+_start_room(struct game* self, struct room* ro) {
+    _set_status(self, ro, RS_START);
+    ro->starttime = ro->statustime;
     UM_DEFFIX(UM_GAMESTART, start);
     _multicast_msg(ro, (void*)start, 0);
 }
@@ -399,10 +506,16 @@ _destory_room(struct game* self, struct room* ro) {
             }
         }
     }
-    if (ro->map) {
-        genmap_free(ro->map);
+    if (ro->mapitem) {
+        genmap_pool_release(self->genpool, ro->mapitem);
+        ro->mapitem = NULL;
         ro->map = NULL;
     }
+    if (ro->tplt) {
+        tplt_release(ro->tplt);
+        ro->tplt = NULL;
+    }
+    _unlink_status(self, ro);
     GFREEID_FREE(room, &self->rooms, ro);
 }
 static bool
@@ -415,12 +528,12 @@ _check_enter_room(struct game* self, struct room* ro) {
     }
     int n = _count_loadokmember(ro);
     if (n == ro->np) {
-        _enter_room(ro);
+        _enter_room(self, ro);
         return true;
     } else {
         if (_elapsed(ro->statustime, ENTER_TIMEOUT)) {
             if (_count_onlinemember(ro) > 0) {
-                _enter_room(ro);
+                _enter_room(self, ro);
                 return true;
             } else {
                 _destory_room(self, ro);
@@ -436,7 +549,7 @@ _check_start_room(struct game* self, struct room* ro) {
         return false;
     }
     if (_elapsed(ro->statustime, START_TIMEOUT)) {
-        _start_room(ro);
+        _start_room(self, ro);
         return true;
     }
     return false;
@@ -590,8 +703,7 @@ _gameover(struct game* self, struct room* ro, bool death) {
     }
 
     // over room
-    ro->status = RS_OVER;
-    ro->statustime = sc_timer_now();
+    _set_status(self, ro, RS_OVER);
 }
 
 static void
@@ -633,22 +745,15 @@ _check_destory_room(struct game* self, struct room* ro) {
 }
 
 static inline const struct map_tplt*
-_maptplt(uint32_t mapid) {
-    const struct tplt_visitor* visitor = tplt_get_visitor(TPLT_MAP);
-    if (visitor) 
-        return tplt_visitor_find(visitor, mapid);
-    return NULL; 
+_maptplt(struct tplt* t, uint32_t mapid) {
+    return tplt_vfind(t, TPLT_MAP, mapid);
 }
 
-static struct genmap*
-_create_map(struct game* self, const struct map_tplt* tplt, uint32_t seed) {
-    struct service_message sm = { tplt->id, 0, sc_cstr_to_int32("GMAP"), 0, NULL };
+static struct roommap*
+_get_roommap(struct game* self, uint32_t mapid) {
+    struct service_message sm = { mapid, 0, sc_cstr_to_int32("GMAP"), 0, NULL };
     service_notify_service(self->tplt_handler, &sm);
-    struct roommap* m = sm.result;
-    if (m == NULL) {
-        return NULL;
-    }
-    return genmap_create(tplt, m, seed);
+    return sm.result;
 }
 
 
@@ -876,6 +981,24 @@ static void dump(uint32_t charid, const char* name, struct char_attribute* attri
 }
 */
 
+static void
+_buff_timeout(void* ud) {
+    struct buff* b = ud;
+    b->owner.timer = 0;
+    struct room* ro;
+    struct member* m = _owner_member(&b->owner, &ro);
+    if (m == NULL)
+        return;
+    sc_debug("timeout : %u, to char %u", b->time, m->detail.charid);
+    b->time = 0;
+    int i;
+    for (i=0; i<BUFF_EFFECT; ++i) {
+        b->effects[i].value *= -1;
+        _item_effectone(m, &b->effects[i]);
+    }
+    _on_refresh_attri(m, ro);
+}
+
 static void
 _item_effect_member(struct game* self, struct room* ro, struct member* m, 
         const struct item_tplt* titem, int addtime) {
@@ -887,6 +1010,7 @@ _item_effect_member(struct game* self, struct room* ro, struct member* m,
         b = idmap_find(m->buffmap, titem->id);
         if (b == NULL) {
             b = malloc(sizeof(*b));
+            _init_owner(&b->owner, self, ro, m, titem->id);
             idmap_insert(m->buffmap, titem->id, b);
             effectptr = b->effects;
         } else {
@@ -897,6 +1021,11 @@ _item_effect_member(struct game* self, struct room* ro, struct member* m,
             }
         }
         b->time = sc_timer_now()/1000 + titem->time + addtime;
+        if (b->owner.timer) {
+            sc_timer_del(b->owner.timer);
+        }
+        int64_t delay = (int64_t)b->time*1000 - (int64_t)sc_timer_now();
+        b->owner.timer = sc_timer_add(delay > 0 ? delay : 1, 0, _buff_timeout, b);
         sc_debug("insert time: %u, to char %u", b->time, m->detail.charid);
     } else {
         effectptr = tmp;
@@ -978,6 +1107,30 @@ _item_effect(struct game* self, struct room* ro, struct member* me,
     }
 }
 
+#define DELAY_RETRY 100
+
+static void
+_delay_timeout(void* ud) {
+    struct buff_delay* bdelay = ud;
+    bdelay->owner.timer = 0;
+    struct room* ro;
+    struct member* m = _owner_member(&bdelay->owner, &ro);
+    if (m == NULL)
+        return;
+    struct game* self = bdelay->owner.self;
+    if (ro->status != RS_START) {
+        bdelay->owner.timer = sc_timer_add(DELAY_RETRY, 0, _delay_timeout, bdelay);
+        return;
+    }
+    int diff = bdelay->last_time > bdelay->effect_time ?
+        bdelay->last_time - bdelay->effect_time : 0;
+    bdelay->effect_time = 0;
+    struct item_tplt* titem = _get_item_tplt(ro, bdelay->owner.itemid);
+    if (titem == NULL)
+        return;
+    _item_effect(self, ro, m, titem, diff);
+}
+
 static void
 _item_delay(struct game* self, struct room* ro, struct member* m, const struct item_tplt* titem, int delay) {
     sc_debug("char %u, use delay titem %u", m->detail.charid, titem->id);
@@ -985,12 +1138,14 @@ _item_delay(struct game* self, struct room* ro, struct member* m, const struct i
     struct buff_delay* bdelay = idmap_find(m->delaymap, titem->id);
     if (bdelay == NULL) {
         bdelay = malloc(sizeof(*bdelay));
+        _init_owner(&bdelay->owner, self, ro, m, titem->id);
         bdelay->effect_time = 0;
         idmap_insert(m->delaymap, titem->id, bdelay);
     }
     bdelay->last_time = sc_timer_now() + delay;
     if (bdelay->effect_time == 0) {
         bdelay->effect_time = bdelay->last_time;
+        bdelay->owner.timer = sc_timer_add(delay, 0, _delay_timeout, bdelay);
     }
 }
 
@@ -1015,15 +1170,15 @@ _rand_baoitem(struct game* self, const struct item_tplt* titem, const struct map
 }
 
 static inline const struct item_tplt*
-_rand_fightitem(struct game* self, const struct map_tplt* tmap) {
+_rand_fightitem(struct room* ro, const struct map_tplt* tmap) {
     uint32_t randid = tmap->fightitem[rand()%tmap->nfightitem];
-    return _get_item_tplt(self, randid);
+    return _get_item_tplt(ro, randid);
 }
 
 static inline const struct item_tplt*
-_rand_trapitem(struct game* self, const struct map_tplt* tmap) {
+_rand_trapitem(struct room* ro, const struct map_tplt* tmap) {
     uint32_t randid = tmap->trapitem[rand()%tmap->ntrapitem];
-    const struct item_tplt* titem = _get_item_tplt(self, randid);
+    const struct item_tplt* titem = _get_item_tplt(ro, randid);
     if (titem == NULL) {
         sc_debug("not found rand item %u", randid);
     }
@@ -1039,13 +1194,13 @@ _use_item(struct game* self, struct gate_client* c, struct UM_BASE* um) {
         return;
 
     UM_CAST(UM_USEITEM, useitem, um);
-    const struct item_tplt* titem = _get_item_tplt(self, useitem->itemid);
+    const struct item_tplt* titem = _get_item_tplt(ro, useitem->itemid);
     if (titem == NULL) {
         sc_debug("not found use item: %u", useitem->itemid);
         return;
     }
     const struct item_tplt* oriitem = titem;
-    const struct map_tplt* tmap = _maptplt(ro->gattri.mapid); 
+    const struct map_tplt* tmap = _maptplt(ro->tplt, ro->gattri.mapid); 
     if (tmap == NULL) {
         return;
     }
@@ -1056,7 +1211,7 @@ _use_item(struct game* self, struct gate_client* c, struct UM_BASE* um) {
         break;
     case ITEM_T_FIGHT:
         if (titem->subtype == 0) {
-            titem = _rand_fightitem(self, tmap);
+            titem = _rand_fightitem(ro, tmap);
             if (titem == NULL) {
                 return;
             }
@@ -1065,7 +1220,7 @@ _use_item(struct game* self, struct gate_client* c, struct UM_BASE* um) {
         break;
     case ITEM_T_TRAP:
         if (titem->subtype == 0) {
-            titem = _rand_trapitem(self, tmap);
+            titem = _rand_trapitem(ro, tmap);
             if (titem == NULL) {
                 return;
             }
@@ -1150,26 +1305,26 @@ _notify_createroomres(const struct sc_node* node,
     UM_SENDTONODE(node, res, sizeof(*res));
 }
 
-static void
-_handle_creategame(struct game* self, struct node_message* nm) {
-    UM_CAST(UM_CREATEROOM, cr, nm->um);
+// the create request wait for the map generate
+struct createroom_wait {
+    struct game* self;
+    uint16_t nodeid;
+    struct tplt* tplt;
+    const struct map_tplt* tmap;
+    char cr[];
+};
 
-    const struct map_tplt* tmap = _maptplt(cr->mapid); 
-    if (tmap == NULL) {
-        _notify_createroomres(nm->hn, SERR_CRENOTPLT, cr->id, cr->key, 0);
-        return;
-    }
-    struct genmap* gm = _create_map(self, tmap, cr->key);
-    if (gm == NULL) {
-        _notify_createroomres(nm->hn, SERR_CRENOMAP, cr->id, cr->key, 0);
-        return;
-    }
+static void
+_createroom(struct game* self, const struct sc_node* node, struct UM_CREATEROOM* cr,
+        struct tplt* t, const struct map_tplt* tmap, struct genmap_item* item) {
     struct room* ro = _create_room(self);
     assert(ro);
+    ro->tplt = t;
     ro->type = cr->type;
     ro->key = cr->key;
-    ro->map = gm; 
-    ro->gattri.randseed = cr->key; // just easy
+    ro->mapitem = item;
+    ro->map = item->map; 
+    ro->gattri.randseed = item->seed; // the client generate the same map
     ro->gattri.mapid = cr->mapid;
     ground_attri_build(tmap->difficulty, &ro->gattri);
 
@@ -1183,71 +1338,89 @@ _handle_creategame(struct game* self, struct node_message* nm) {
         //dump(m->detail.charid, m->detail.name, &m->detail.attri);
     }
     int roomid = GFREEID_ID(ro, &self->rooms);
-    _notify_createroomres(nm->hn, SERR_OK, cr->id, cr->key, roomid);
+    _notify_createroomres(node, SERR_OK, cr->id, cr->key, roomid);
 }
 
 static void
-_handle_destroyroom(struct game* self, struct UM_BASE* um) {
-    UM_CAST(UM_CREATEROOMRES, dr, um);
-    struct room* ro = _getroom(self, dr->roomid);
-    if (ro && (ro->status == RS_CREATE)) {
-        _destory_room(self, ro);
+_genmap_done(void* ud, struct genmap_item* item) {
+    struct createroom_wait* w = ud;
+    struct game* self = w->self;
+    UM_CAST(UM_CREATEROOM, cr, w->cr);
+    const struct sc_node* node = self->closing ? NULL : sc_node_get(w->nodeid);
+    if (item && node) {
+        _createroom(self, node, cr, w->tplt, w->tmap, item);
+    } else {
+        if (node) {
+            _notify_createroomres(node, SERR_CRENOMAP, cr->id, cr->key, 0);
+        }
+        if (item) {
+            genmap_pool_release(self->genpool, item);
+        }
+        tplt_release(w->tplt);
     }
+    free(w);
 }
 
-struct _update_delayud {
-    struct game* self;
-    struct room* ro;
-    struct member* m;
-};
 static void
-_update_delaycb(uint32_t key, void* value, void* ud) {
-    uint32_t itemid = key;
-    struct _update_delayud* udata = ud;
-    struct game* self = udata->self;
-    struct room* ro = udata->ro;
-    struct member* m = udata->m;
-    struct buff_delay* bdelay = value;
-    if (bdelay->effect_time > 0) {
-        if (bdelay->effect_time <= sc_timer_now()) {
-            struct item_tplt* titem = _get_item_tplt(self, itemid);
-            if (titem == NULL)
-                return;
-            int diff = bdelay->last_time > bdelay->effect_time ?
-                bdelay->last_time - bdelay->effect_time : 0;
-            _item_effect(self, ro, m, titem, diff);
-
-            bdelay->effect_time = 0;
-        }
+_genmap_poll(void* ud) {
+    struct game* self = ud;
+    if (genmap_pool_poll(self->genpool) == 0) {
+        sc_timer_del(self->gentimer);
+        self->gentimer = 0;
     }
 }
 
+// the room key is unique, draw the seed from the small set to hit the cache
+static inline uint32_t
+_mapseed(struct game* self, uint32_t key) {
+    if (self->genseed > 0)
+        return key % self->genseed;
+    return key;
+}
+
 static void
-_update_buffcb(uint32_t key, void* value, void* ud) {
-    struct member* m = ud;
-    struct buff* b = value;
-    if (b->time > 0 &&
-        b->time <= sc_timer_now()/1000) {
-        sc_debug("timeout : %u, to char %u", b->time, m->detail.charid);
-        b->time = 0;
-        int i;
-        for (i=0; i<BUFF_EFFECT; ++i) {
-            b->effects[i].value *= -1;
-            _item_effectone(m, &b->effects[i]);
-        }
+_handle_creategame(struct game* self, struct node_message* nm) {
+    UM_CAST(UM_CREATEROOM, cr, nm->um);
+
+    struct tplt* t = tplt_acquire();
+    const struct map_tplt* tmap = _maptplt(t, cr->mapid); 
+    if (tmap == NULL) {
+        if (t) tplt_release(t);
+        _notify_createroomres(nm->hn, SERR_CRENOTPLT, cr->id, cr->key, 0);
+        return;
+    }
+    struct roommap* m = _get_roommap(self, tmap->id);
+    if (m == NULL) {
+        tplt_release(t);
+        _notify_createroomres(nm->hn, SERR_CRENOMAP, cr->id, cr->key, 0);
+        return;
+    }
+    uint32_t seed = _mapseed(self, cr->key);
+    struct genmap_item* item = genmap_pool_find(self->genpool, tmap->id, m, seed);
+    if (item) {
+        _createroom(self, nm->hn, cr, t, tmap, item);
+        return;
+    }
+    // generate in the pool, reply UM_CREATEROOMRES when done
+    int sz = UM_CREATEROOM_size(cr);
+    struct createroom_wait* w = malloc(sizeof(*w) + sz);
+    w->self = self;
+    w->nodeid = nm->hn->id;
+    w->tplt = t;
+    w->tmap = tmap;
+    memcpy(w->cr, cr, sz);
+    genmap_pool_request(self->genpool, tmap, m, seed, _genmap_done, w);
+    if (self->gentimer == 0) {
+        self->gentimer = sc_timer_add(10, 10, _genmap_poll, self);
     }
 }
 
 static void
-_update_delay(struct game* self, struct room* ro) {
-    struct member* m;
-    int i;
-    for (i=0; i<ro->np; ++i) {
-        m = &ro->p[i];
-        if (m->online) {
-            struct _update_delayud ud1 = {self, ro, m };
-            idmap_foreach(m->delaymap, _update_delaycb, &ud1);
-        }
+_handle_destroyroom(struct game* self, struct UM_BASE* um) {
+    UM_CAST(UM_CREATEROOMRES, dr, um);
+    struct room* ro = _getroom(self, dr->roomid);
+    if (ro && (ro->status == RS_CREATE)) {
+        _destory_room(self, ro);
     }
 }
 
@@ -1262,7 +1435,6 @@ _update_room(struct game* self, struct room* ro) {
             if (_reduce_oxygen(m, oxygen) > 0) {
                 m->refresh_flag |= REFRESH_ATTRI;
             }
-            idmap_foreach(m->buffmap, _update_buffcb, m);
             //bool d = m->refresh_flag & REFRESH_SPEED;
             _on_refresh_attri(m, ro);
             //if (d) {
@@ -1307,40 +1479,110 @@ game_net(struct service* s, struct gate_message* gm) {
     }
 }
 
+static inline uint64_t
+_elapsed_us() {
+    struct timespec ti;
+    clock_gettime(CLOCK_MONOTONIC, &ti);
+    return (uint64_t)ti.tv_sec * 1000000 + ti.tv_nsec / 1000;
+}
+
+static int
+_cmp_tick(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void
+_report_load(struct game* self) {
+    UM_DEFFIX(UM_LOADREPORT, lr);
+    struct sc_node_loadreport* r = &lr->report;
+    r->rooms = self->nroom;
+    r->clients = sc_gate_usedclient();
+    r->tick_avg = 0;
+    r->tick_p99 = 0;
+    int n = min(self->ntick, TICK_SAMPLE);
+    if (n > 0) {
+        int ticks[TICK_SAMPLE];
+        int64_t sum = 0;
+        int i;
+        for (i=0; i<n; ++i) {
+            ticks[i] = self->ticks[i];
+            sum += ticks[i];
+        }
+        qsort(ticks, n, sizeof(ticks[0]), _cmp_tick);
+        r->tick_avg = sum / n;
+        r->tick_p99 = ticks[(n-1) * 99 / 100];
+    }
+    int64_t bytes = sc_net_sendbytes();
+    r->sendbytes = bytes < INT_MAX ? bytes : INT_MAX;
+    _sendto_world((void*)lr, lr->msgsz);
+}
+
+/*
+ * each status list is in order of statustime, so the timeout check stop
+ * at the first room not due. walk the lists from the last status, so a room
+ * changes status in this tick is not handle again, as the slot scan before
+ */
+static int
+_tick_status(struct game* self) {
+    struct room* ro;
+    int id, next;
+
+    id = IDLIST_HEAD(&self->status[RS_OVER]);
+    while ((ro = _roomat(self, id))) {
+        next = ro->lnext;
+        if (!_elapsed(ro->statustime, DESTROY_TIMEOUT))
+            break;
+        _check_destory_room(self, ro);
+        id = next;
+    }
+    id = IDLIST_HEAD(&self->status[RS_START]);
+    while ((ro = _roomat(self, id))) {
+        next = ro->lnext;
+        _update_room(self, ro);
+        _check_over_room(self, ro);
+        id = next;
+    }
+    id = IDLIST_HEAD(&self->status[RS_ENTER]);
+    while ((ro = _roomat(self, id))) {
+        next = ro->lnext;
+        if (!_check_start_room(self, ro))
+            break;
+        id = next;
+    }
+    id = IDLIST_HEAD(&self->status[RS_CREATE]);
+    while ((ro = _roomat(self, id))) {
+        next = ro->lnext;
+        if (!_elapsed(ro->statustime, ENTER_TIMELEAST))
+            break;
+        _check_enter_room(self, ro);
+        id = next;
+    }
+    int nroom = 0;
+    int i;
+    for (i=0; i<RS_MAX; ++i) {
+        nroom += IDLIST_COUNT(&self->status[i]);
+    }
+    return nroom;
+}
+
 void
 game_time(struct service* s) {
     struct game* self = SERVICE_SELF;
-    struct room* ro;
-    int i;
 
-    if (++self->tick == 10) {
-        self->tick = 0;
-    }
-    for (i=0; i<GFREEID_CAP(&self->rooms); ++i) {
-        ro = GFREEID_SLOT(&self->rooms, i);
-        if (ro) {
-            if (self->tick == 0) {
-                switch (ro->status) {
-                case RS_CREATE:
-                    _check_enter_room(self, ro);
-                    break;
-                case RS_ENTER:
-                    _check_start_room(self, ro);
-                    break;
-                case RS_START:
-                    _update_room(self, ro);
-                    _check_over_room(self, ro);
-                    break;
-                case RS_OVER:
-                    _check_destory_room(self, ro);
-                    break;
-                }
-            }
-            switch (ro->status) {
-            case RS_START:
-                _update_delay(self, ro);
-                break;
-            }
+    uint64_t start = _elapsed_us();
+    int nroom = _tick_status(self);
+    // no room pointer is hold here, safe to realloc
+    if (++self->shrink_tick >= ROOM_SHRINK_TICK) {
+        self->shrink_tick = 0;
+        if (nroom * 4 < GFREEID_CAP(&self->rooms)) {
+            GFREEID_SHRINK(room, &self->rooms, ROOM_POOL_MIN);
         }
     }
+    self->nroom = nroom;
+    self->ticks[self->ntick++ % TICK_SAMPLE] = _elapsed_us() - start;
+    if (self->report_interval > 0 &&
+        ++self->report_tick >= self->report_interval) {
+        self->report_tick = 0;
+        _report_load(self);
+    }
 }
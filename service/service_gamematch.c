@@ -1,5 +1,6 @@
 #include "sc_service.h"
 #include "sc_util.h"
+#include "sc_env.h"
 #include "sc_node.h"
 #include "sc_timer.h"
 #include "sc_dispatcher.h"
@@ -11,10 +12,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
 
 #define CREATE_TIMEOUT 5000
 
+/*
+ * the waiters of each room type are bucketed by level grade (normal) 
+ * or score_dashi (dashi), each bucket is a min heap by join order.
+ * the match pass run in each time, the oldest waiter of a bucket anchor
+ * a room, the bucket range widen with the wait time.
+ */
+#define MATCH_TYPE_MAX 2
+#define BUCKET_MAX 16
+
 struct matchtag {
     uint16_t gid;
     uint16_t cid;
@@ -46,11 +57,47 @@ struct gfroom {
     GFREEID_FIELDS(room);
 };
 
+struct waiter {
+    int id;
+    int used;
+    uint16_t gid;
+    uint16_t cid;
+    uint32_t charid;
+    int8_t type;
+    int8_t bucket;
+    int heapidx;
+    uint64_t seq; // join order
+    uint64_t jointime;
+};
+
+struct gfwaiter {
+    GFREEID_FIELDS(waiter);
+};
+
+// min heap of waiter id
+struct waitheap {
+    int* p;
+    int n;
+    int cap;
+};
+
+struct matchqueue {
+    int nbucket;
+    struct waitheap buckets[BUCKET_MAX];
+};
+
 struct gamematch {
     int award_handler;
     uint32_t randseed;
     uint32_t key;
-    struct matchtag mtag;
+    uint64_t seq;
+    int room_member;  // max member of room
+    int min_member;   // least member to start room, after fill_time
+    int fill_time;    // ms
+    int widen_time;   // ms, widen one bucket each
+    int dashi_step;   // score_dashi of one bucket
+    struct gfwaiter waiters;
+    struct matchqueue queues[MATCH_TYPE_MAX];
     struct gfroom creating;
 };
 
@@ -65,6 +112,14 @@ void
 gamematch_free(struct gamematch* self) {
     if (self == NULL)
         return;
+    int i, n;
+    for (i=0; i<MATCH_TYPE_MAX; ++i) {
+        struct matchqueue* q = &self->queues[i];
+        for (n=0; n<BUCKET_MAX; ++n) {
+            free(q->buckets[n].p);
+        }
+    }
+    GFREEID_FINI(waiter, &self->waiters);
     GFREEID_FINI(room, &self->creating);
     free(self);
 }
@@ -77,13 +132,29 @@ gamematch_init(struct service* s) {
 
     self->randseed = time(NULL);
 
+    self->room_member = sc_getint("gamematch_member", MEMBER_MAX);
+    if (self->room_member < 2 || self->room_member > MEMBER_MAX)
+        self->room_member = MEMBER_MAX;
+    self->min_member = sc_getint("gamematch_min_member", 2);
+    if (self->min_member < 2 || self->min_member > self->room_member)
+        self->min_member = 2;
+    self->fill_time = sc_getint("gamematch_fill_time", 10000);
+    self->widen_time = sc_getint("gamematch_widen_time", 5000);
+    self->dashi_step = sc_getint("gamematch_dashi_step", 100);
+    if (self->dashi_step <= 0)
+        self->dashi_step = 100;
+    self->queues[ROOM_TYPE_NORMAL].nbucket = LV_MAX;
+    self->queues[ROOM_TYPE_DASHI].nbucket = BUCKET_MAX;
+
     // todo test this
     GFREEID_INIT(room, &self->creating, 1);
+    GFREEID_INIT(waiter, &self->waiters, 64);
 
     SUBSCRIBE_MSG(s->serviceid, IDUM_PLAY);
     SUBSCRIBE_MSG(s->serviceid, IDUM_LOGOUT);
     SUBSCRIBE_MSG(s->serviceid, IDUM_CREATEROOMRES);
     SUBSCRIBE_MSG(s->serviceid, IDUM_OVERROOM);
+    SUBSCRIBE_MSG(s->serviceid, IDUM_LOADREPORT);
 
     sc_timer_register(s->serviceid, 1000);
     return 0;
@@ -111,9 +182,10 @@ _genkey(struct gamematch* self) {
     return self->key++;
 }
 
+// the estimate until the next load report of the game node
 static int
 _calcload(int8_t type) {
-    return 2;
+    return sc_node_roomload();
 }
 
 static void
@@ -156,10 +228,109 @@ _clear_matchtag(struct matchtag* mtag) {
     mtag->name[0] = '\0';
 }
 
+static inline bool
+_heap_less(struct gamematch* self, int a, int b) {
+    return self->waiters.p[a].seq < self->waiters.p[b].seq;
+}
+
+static inline void
+_heap_set(struct gamematch* self, struct waitheap* h, int i, int wid) {
+    h->p[i] = wid;
+    self->waiters.p[wid].heapidx = i;
+}
+
+static void
+_heap_up(struct gamematch* self, struct waitheap* h, int i) {
+    int wid = h->p[i];
+    while (i > 0) {
+        int parent = (i-1)/2;
+        if (!_heap_less(self, wid, h->p[parent]))
+            break;
+        _heap_set(self, h, i, h->p[parent]);
+        i = parent;
+    }
+    _heap_set(self, h, i, wid);
+}
+
+static void
+_heap_down(struct gamematch* self, struct waitheap* h, int i) {
+    int wid = h->p[i];
+    for (;;) {
+        int child = i*2+1;
+        if (child >= h->n)
+            break;
+        if (child+1 < h->n && _heap_less(self, h->p[child+1], h->p[child]))
+            child++;
+        if (!_heap_less(self, h->p[child], wid))
+            break;
+        _heap_set(self, h, i, h->p[child]);
+        i = child;
+    }
+    _heap_set(self, h, i, wid);
+}
+
+static void
+_heap_push(struct gamematch* self, struct waitheap* h, int wid) {
+    if (h->n >= h->cap) {
+        h->cap = h->cap ? h->cap*2 : 16;
+        h->p = realloc(h->p, sizeof(int) * h->cap);
+    }
+    h->p[h->n++] = wid;
+    _heap_up(self, h, h->n-1);
+}
+
+static void
+_heap_remove(struct gamematch* self, struct waitheap* h, int i) {
+    assert(i >= 0 && i < h->n);
+    int last = h->p[--h->n];
+    if (i < h->n) {
+        _heap_set(self, h, i, last);
+        _heap_up(self, h, i);
+        _heap_down(self, h, self->waiters.p[last].heapidx);
+    }
+}
+
+static int
+_bucket(struct gamematch* self, const struct player* p, int8_t type) {
+    const struct chardata* data = &p->data;
+    int b;
+    if (type == ROOM_TYPE_DASHI) {
+        b = data->score_dashi / self->dashi_step;
+    } else {
+        b = _player_gradeid(data->level);
+    }
+    int nbucket = self->queues[type].nbucket;
+    return b < nbucket ? b : nbucket-1;
+}
+
+static void
+_add_waitmember(struct gamematch* self, struct player* p, int8_t type, uint64_t jointime, uint64_t seq) {
+    struct waiter* w = GFREEID_ALLOC(waiter, &self->waiters);
+    w->gid = p->gid;
+    w->cid = p->cid;
+    w->charid = p->data.charid;
+    w->type = type;
+    w->bucket = _bucket(self, p, type);
+    w->seq = seq;
+    w->jointime = jointime;
+    int wid = GFREEID_ID(w, &self->waiters);
+    _heap_push(self, &self->queues[type].buckets[w->bucket], wid);
+    p->status = PS_WAITING;
+    p->roomid = wid;
+}
+
+static void
+_free_waiter(struct gamematch* self, struct waiter* w) {
+    struct waitheap* h = &self->queues[w->type].buckets[w->bucket];
+    _heap_remove(self, h, w->heapidx);
+    GFREEID_FREE(waiter, &self->waiters, w);
+}
+
 static void
 _del_waitmember(struct gamematch* self, struct player* p) {
-    if (p->data.charid == self->mtag.charid) {
-        _clear_matchtag(&self->mtag);
+    struct waiter* w = GFREEID_SLOT(&self->waiters, p->roomid);
+    if (w && w->charid == p->data.charid) {
+        _free_waiter(self, w);
     }
 }
 
@@ -262,69 +433,152 @@ _timeout_tmproom(struct gamematch* self) {
 }
 
 static int
-_match(struct gamematch* self, struct player* p, struct player* mp, int8_t type) {
+_match(struct gamematch* self, struct player** ps, int np, int8_t type) {
     const struct sc_node* hn = sc_node_minload(NODE_GAME);
     if (hn == NULL) {
         return 1;
     }
-    UM_DEFFORWARD(fw, p->cid, UM_PLAYLOADING, pl);
+    UM_DEFFORWARD(fw, 0, UM_PLAYLOADING, pl);
     pl->leasttime = ROOM_LOAD_TIMELEAST;
-    _build_memberbrief(mp, &pl->member);
-    _forward_toplayer(p, fw);
-
-    fw->cid = mp->cid;
-    _build_memberbrief(p, &pl->member);
-    _forward_toplayer(mp, fw);
-
+    int i, j;
+    for (i=0; i<np; ++i) {
+        fw->cid = ps[i]->cid;
+        for (j=0; j<np; ++j) {
+            if (j != i) {
+                _build_memberbrief(ps[j], &pl->member);
+                _forward_toplayer(ps[i], fw);
+            }
+        }
+    }
     struct room* ro = _create_tmproom(self); 
     ro->type = type;
     ro->sid = hn->sid; 
-    _build_matchtag(p, &ro->mtag.p[0]);
-    _build_matchtag(mp, &ro->mtag.p[1]);
-    ro->mtag.np = 2;
 
     UM_DEFVAR(UM_CREATEROOM, cr);
     cr->type = type;
     cr->mapid = 1;//sc_rand(self->randseed) % 2 + 1; // 1,2 todo
     cr->id = GFREEID_ID(ro, &self->creating);
     cr->key = ro->key;
-    _build_memberdetail(p, &cr->members[0]);
-    _build_memberdetail(mp, &cr->members[1]);
-    cr->nmember = ro->mtag.np;
+    for (i=0; i<np; ++i) {
+        _build_matchtag(ps[i], &ro->mtag.p[i]);
+        _build_memberdetail(ps[i], &cr->members[i]);
+        ps[i]->roomid = cr->id;
+    }
+    ro->mtag.np = np;
+    cr->nmember = np;
 
     UM_SENDTONODE(hn, cr, UM_CREATEROOM_size(cr));
     sc_node_updateload(hn->id, _calcload(cr->type));
     return 0;
 }
 
+static inline struct waiter*
+_heap_top(struct gamematch* self, struct waitheap* h) {
+    return h->n > 0 ? &self->waiters.p[h->p[0]] : NULL;
+}
+
+// the bucket has the oldest top in [lo, hi], -1 if none
 static int
-_lookup(struct gamematch* self, struct player* p, int8_t type) {
-    struct matchtag* mtag = &self->mtag;
-    struct player* mp = _getplayerbycharid(mtag->charid);
-    if (mp == NULL) {
-        p->status = PS_WAITING;
-        _build_matchtag(p, mtag);
-
-        UM_DEFFORWARD(fw, p->cid, UM_PLAYWAIT, pw);
-        pw->timeout = 60; // todo just test
-        _forward_toplayer(p, fw);
-        return 0;
+_oldest_bucket(struct gamematch* self, struct matchqueue* q, int lo, int hi, const bool* skip) {
+    int b = -1;
+    uint64_t seq = 0;
+    int i;
+    for (i=lo; i<=hi; ++i) {
+        if (skip && skip[i])
+            continue;
+        struct waiter* w = _heap_top(self, &q->buckets[i]);
+        if (w && (b == -1 || w->seq < seq)) {
+            b = i;
+            seq = w->seq;
+        }
+    }
+    return b;
+}
+
+// form one room anchored by the top of bucket b, return 0 if formed
+static int
+_formroom(struct gamematch* self, int8_t type, int b, uint64_t now) {
+    struct matchqueue* q = &self->queues[type];
+    struct waiter* anchor = _heap_top(self, &q->buckets[b]);
+    uint64_t wait = now > anchor->jointime ? now - anchor->jointime : 0;
+    int tol = self->widen_time > 0 ? wait / self->widen_time : BUCKET_MAX;
+    int lo = max(0, b - tol);
+    int hi = min(q->nbucket-1, b + tol);
+    int avail = 0;
+    int i;
+    for (i=lo; i<=hi; ++i) {
+        avail += q->buckets[i].n;
+    }
+    int np = min(avail, self->room_member);
+    if (np < self->room_member) {
+        if (wait < self->fill_time || np < self->min_member)
+            return 1;
+    }
+    struct player* ps[MEMBER_MAX];
+    uint64_t jointimes[MEMBER_MAX];
+    uint64_t seqs[MEMBER_MAX];
+    int n = 0;
+    for (i=0; i<np; ++i) {
+        struct waiter* w = _heap_top(self, &q->buckets[_oldest_bucket(self, q, lo, hi, NULL)]);
+        struct player* p = _getplayer(w->gid, w->cid);
+        if (p && p->data.charid == w->charid && p->status == PS_WAITING) {
+            jointimes[n] = w->jointime;
+            seqs[n] = w->seq;
+            ps[n++] = p;
+        }
+        _free_waiter(self, w);
+    }
+    if (n < self->min_member) {
+        // some one gone, wait again in the old order
+        for (i=0; i<n; ++i) {
+            _add_waitmember(self, ps[i], type, jointimes[i], seqs[i]);
+        }
+        return n > 0 ? 1 : 0;
+    }
+    int status;
+    if (_match(self, ps, n, type)) {
+        for (i=0; i<n; ++i) {
+            _notify_playfail(ps[i], 0);
+        }
+        status = PS_GAME;
     } else {
-        _clear_matchtag(mtag);
-        if (_match(self, p, mp, type)) {
-            _notify_playfail(p, 0);
-            _notify_playfail(mp, 0);
-            p->status = PS_GAME;
-            mp->status = PS_GAME;
+        status = PS_CREATING;
+    }
+    for (i=0; i<n; ++i) {
+        ps[i]->status = status;
+    }
+    return 0;
+}
 
-        } else {
-            p->status = PS_CREATING;
-            mp->status = PS_CREATING;
+static void
+_matchpass(struct gamematch* self, int8_t type) {
+    struct matchqueue* q = &self->queues[type];
+    uint64_t now = sc_timer_now();
+    bool skip[BUCKET_MAX];
+    memset(skip, 0, sizeof(skip));
+    for (;;) {
+        int b = _oldest_bucket(self, q, 0, q->nbucket-1, skip);
+        if (b == -1)
+            break;
+        if (_formroom(self, type, b, now)) {
+            skip[b] = true;
         }
-        return 0;
     }
 }
 
+static int
+_lookup(struct gamematch* self, struct player* p, int8_t type) {
+    if (type < 0 || type >= MATCH_TYPE_MAX) {
+        return 1;
+    }
+    _add_waitmember(self, p, type, sc_timer_now(), ++self->seq);
+
+    UM_DEFFORWARD(fw, p->cid, UM_PLAYWAIT, pw);
+    pw->timeout = 60; // todo just test
+    _forward_toplayer(p, fw);
+    return 0;
+}
+
 static void
 _onoverroom(struct gamematch* self, struct node_message* nm) {
     UM_CAST(UM_OVERROOM, or, nm->um);
@@ -338,6 +592,8 @@ _onoverroom(struct gamematch* self, struct node_message* nm) {
         p = _getplayerbycharid(or->awards[i].charid);
         if (p == NULL)
             continue;
+        if (p->status == PS_ROOM)
+            p->status = PS_GAME; // can play again
         allp[n++] = p;
     }
     struct service_message sm;
@@ -370,6 +626,11 @@ _oncreateroom(struct gamematch* self, struct node_message* nm) {
 static void
 _playreq(struct gamematch* self, struct player_message* pm) {
     UM_CAST(UM_PLAY, um, pm->um);
+    // already in the queue or a room creating
+    if (pm->p->status == PS_WAITING ||
+        pm->p->status == PS_CREATING) {
+        return;
+    }
     _lookup(self, pm->p, um->type);
 }
 
@@ -395,6 +656,11 @@ _handlegame(struct gamematch* self, struct node_message* nm) {
     case IDUM_CREATEROOMRES:
         _oncreateroom(self, nm);
         break;
+    case IDUM_LOADREPORT: {
+        UM_CAST(UM_LOADREPORT, lr, nm->um);
+        sc_node_report(nm->hn->id, &lr->report);
+        }
+        break;
     }
 }
 
@@ -432,4 +698,8 @@ void
 gamematch_time(struct service* s) {
     struct gamematch* self= SERVICE_SELF;
     _timeout_tmproom(self);
+    int8_t type;
+    for (type=0; type<MATCH_TYPE_MAX; ++type) {
+        _matchpass(self, type);
+    }
 }
@@ -25,6 +25,7 @@
 struct gate {
     int handler;
     int livetime;
+    int budget; // max messages handle in one read event
     bool need_verify;
     bool need_load;
 };
@@ -63,7 +64,7 @@ gate_init(struct service* s) {
     if (_listen(s))
         return 1;
     int cmax = sc_getint("gate_clientmax", 0);
-    int hmax = sc_getint("sc_connmax", cmax);
+    int hmax = sc_net_max_socket();
     if (sc_gate_prepare(cmax, hmax)) {
         return 1;
     }
@@ -73,6 +74,9 @@ gate_init(struct service* s) {
     self->need_load = sc_getint("gate_load", 0);
     int live = sc_getint("gate_clientlive", 3);
     self->livetime = live * 1000;
+    self->budget = sc_getint("gate_read_budget", 10);
+    if (self->budget < 1)
+        self->budget = 1;
     sc_timer_register(s->serviceid, 1000);
     return 0;
 }
@@ -80,7 +84,7 @@ gate_init(struct service* s) {
 static inline void
 _handlemsg(struct gate* self, struct gate_client* c, struct UM_BASE* um) {
     if (c->status == GATE_CLIENT_LOGINED) {
-        c->active_time = sc_timer_now();
+        sc_gate_activeclient(c);
     }
     if (um->msgid != IDUM_HEARTBEAT) {
         sc_debug("Receive msg:%u",  um->msgid);
@@ -111,8 +115,13 @@ _read(struct gate* self, struct gate_client* c, struct net_message* nm) {
             msg->nodeid = 0;
             memcpy(&msg->cli_base, one, UM_CLI_SZ(one));
             _handlemsg(self, c, msg);
-            if (++step > 10) {
+            if (sc_net_socket_isclosed(id)) {
+                return; // closed by handler, the read buffer is gone
+            }
+            if (++step >= self->budget) {
+                // leave the rest to next poll, other clients go first
                 sc_net_dropread(id, nread-buf.sz);
+                sc_net_requeue(id);
                 return;
             }
         }
@@ -187,45 +196,29 @@ gate_net(struct service* s, struct net_message* nm) {
     }
 }
 
+// only the expired clients are visit, see sc_gate_expireclient
 void
 gate_time(struct service* s) {
     struct gate* self = SERVICE_SELF; 
-    uint64_t now = sc_timer_now();
-    
-    struct gate_client* p = sc_gate_firstclient();
     struct gate_client* c;
-    int max = sc_gate_maxclient();
-    int i;
-    for (i=0; i<max; ++i) {
-        c = &p[i];
-        switch (c->status) {
-        case GATE_CLIENT_CONNECTED:
-            if (now - c->active_time > 10*1000) {
-                sc_debug("login timeout");
-                sc_gate_disconnclient(c, true);
-            }
-            break;
-        case GATE_CLIENT_LOGINED:
-            if (self->livetime > 0 &&
-                self->livetime < now - c->active_time) {
-                sc_debug("heartbeat timeout");
-                struct gate_message gm;
-                struct net_message nm;
-                nm.type = NETE_TIMEOUT;
-                gm.c = c;
-                gm.msg = &nm;
-                service_notify_net(self->handler, (void*)&gm);
-                sc_gate_disconnclient(c, true);
-            }
-            break;
-        case GATE_CLIENT_LOGOUTED:
-            if (now - c->active_time > 5*1000) {
-                sc_debug("logout timeout");
-                sc_gate_disconnclient(c, true);
-            }
-            break;
-        default:
-            break;
+    while ((c = sc_gate_expireclient(GATE_CLIENT_CONNECTED, 10*1000))) {
+        sc_debug("login timeout");
+        sc_gate_disconnclient(c, true);
+    }
+    if (self->livetime > 0) {
+        while ((c = sc_gate_expireclient(GATE_CLIENT_LOGINED, self->livetime))) {
+            sc_debug("heartbeat timeout");
+            struct gate_message gm;
+            struct net_message nm;
+            nm.type = NETE_TIMEOUT;
+            gm.c = c;
+            gm.msg = &nm;
+            service_notify_net(self->handler, (void*)&gm);
+            sc_gate_disconnclient(c, true);
         }
     }
+    while ((c = sc_gate_expireclient(GATE_CLIENT_LOGOUTED, 5*1000))) {
+        sc_debug("logout timeout");
+        sc_gate_disconnclient(c, true);
+    }
 }
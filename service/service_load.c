@@ -61,11 +61,7 @@ load_nodemsg(struct service* s, int id, void* msg, int sz) {
     if (node->tid == self->source) {
         const struct sc_node* dest = sc_node_minload(self->dest);
         if (dest) {
-            UM_DEFVAR(UM_FORWARD, fw);
-            fw->cid = node->id;
-            memcpy(&fw->wrap, um, um->msgsz);
-            fw->wrap.nodeid = sc_id();
-            UM_SENDTONODE(dest, fw, UM_FORWARD_size(fw));
+            UM_SENDWRAP(dest->connid, node->id, um);
         } else {
             UM_DEFFIX(UM_MINLOADFAIL, fail);
             UM_SENDTONODE(node, fail, fail->msgsz);
@@ -11,6 +11,7 @@
 #include "user_message.h"
 #include "node_type.h"
 #include "memrw.h"
+#include "idlist.h"
 #include "util.h"
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +28,7 @@ struct player {
     int connid;
     int state;  // see STATE_*
     uint64_t login_time;
+    IDLIST_LINK;
     uint32_t accid;
     uint64_t key;
     char account[ACCOUNT_NAME_MAX];
@@ -36,6 +38,7 @@ struct player {
 struct login {
     int pmax;
     struct player* players;
+    struct idlist logining; // in order of login_time
     struct redis_reply reply;
     uint32_t key;
 };
@@ -65,6 +68,7 @@ login_init(struct service* s) {
     self->pmax = pmax;
     self->players = malloc(sizeof(struct player) * pmax);
     memset(self->players, 0, sizeof(struct player) * pmax);
+    IDLIST_INIT(&self->logining);
    
     redis_initreply(&self->reply, 512, 0);
     SUBSCRIBE_MSG(s->serviceid, IDUM_ACCOUNTLOGINRES);
@@ -119,7 +123,10 @@ _notify_loginfail(struct gate_client* c, int error) {
 }
 
 static void
-_logout(struct gate_client* c, struct player* p, bool forcedisconn) {
+_logout(struct login* self, struct gate_client* c, struct player* p, bool forcedisconn) {
+    if (p->state != STATE_FREE) {
+        IDLIST_REMOVE(&self->logining, self->players, p - self->players);
+    }
     p->state = STATE_FREE;
     bool closed = sc_gate_disconnclient(c, forcedisconn);
     sc_debug("logout connid %d, acc %s, closed %d", p->connid, p->account, (int)closed);
@@ -131,7 +138,7 @@ _login(struct login* self, struct gate_client* c, struct UM_BASE* um) {
     assert(p);
     if (p->state != STATE_FREE) {
         sc_debug("acc %u, state %d", p->accid, p->state);
-        //_logout(c, p, SERR_RELOGIN, true); maybe client click login button more then once
+        //_logout(self, c, p, SERR_RELOGIN, true); maybe client click login button more then once
         return;
     }
     UM_CAST(UM_LOGINACCOUNT, la, um);
@@ -139,13 +146,14 @@ _login(struct login* self, struct gate_client* c, struct UM_BASE* um) {
     strncpychk(p->passwd, sizeof(p->passwd), la->passwd, sizeof(la->passwd));
     if (_query(self, c, p)) {
         _notify_loginfail(c, SERR_NODB);
-        _logout(c, p, false);
+        _logout(self, c, p, false);
         return;
     }
     sc_gate_loginclient(c);
     p->connid = c->connid;
     p->state = STATE_LOGIN;
     p->login_time = sc_timer_now();
+    IDLIST_PUSHBACK(&self->logining, self->players, p - self->players);
     sc_debug("login connid %d, acc %s", c->connid, p->account);
 }
 
@@ -177,7 +185,7 @@ _handle_redis(struct login* self, struct node_message* nm) {
 
     UM_CAST(UM_REDISREPLY, rep, nm->um);
     struct memrw rw;
-    memrw_init(&rw, rep->data, rep->msgsz - sizeof(*rep));
+    memrw_init(&rw, rep->data, nm->sz - sizeof(*rep));
     int cid = -1;
     memrw_read(&rw, &cid, sizeof(cid));
     struct gate_client* c = sc_gate_getclient(cid);
@@ -246,7 +254,7 @@ _handle_redis(struct login* self, struct node_message* nm) {
     return; 
 err_out:
     _notify_loginfail(c, error);
-    _logout(c, p, false);
+    _logout(self, c, p, false);
 }
 
 static void
@@ -282,10 +290,10 @@ _loginres(struct login* self, struct UM_BASE* um) {
                 UM_SENDTOCLI(c->connid, base, base->msgsz);
             }
 */
-            _logout(c, p, false); 
+            _logout(self, c, p, false); 
         } else {
             _notify_loginfail(c, SERR_REGGATE);
-            _logout(c, p, false);
+            _logout(self, c, p, false);
         }
     } else {
         return; // maybe disconnect, then other connected and not gateload 
@@ -330,13 +338,13 @@ login_net(struct service* s, struct gate_message* gm) {
     case NETE_SOCKERR:
         p = _getonlineplayer(self, gm->c);
         if (p) {
-            _logout(gm->c, p, true);
+            _logout(self, gm->c, p, true);
         }
         break;
     case NETE_TIMEOUT:
         p = _getonlineplayer(self, gm->c);
         if (p) {
-            _logout(gm->c, p, true);
+            _logout(self, gm->c, p, true);
         }
         break;
     default:
@@ -351,17 +359,16 @@ login_time(struct service* s) {
    
     struct player* p;
     struct gate_client* c;
-    int i;
-    for (i=0; i<self->pmax; ++i) {
-        p = &self->players[i];
-        if (p->state >= STATE_LOGIN &&
-            p->state <  STATE_DONE) {
-            if (now - p->login_time > 5*1000) { // short connection mode
-                sc_debug("timeout connid %d, acc %s, state %d", p->connid, p->account, p->state);
-                c = sc_gate_getclient(p->connid);
-                assert(c);
-                _logout(c, p, true);
-            }
+    int id;
+    while ((id = IDLIST_HEAD(&self->logining)) >= 0) {
+        p = &self->players[id];
+        if (now <= p->login_time || now - p->login_time <= 5*1000) {
+            break;
         }
+        // short connection mode
+        sc_debug("timeout connid %d, acc %s, state %d", p->connid, p->account, p->state);
+        c = sc_gate_getclient(p->connid);
+        assert(c);
+        _logout(self, c, p, true);
     }
 }
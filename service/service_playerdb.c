@@ -21,6 +21,7 @@
 struct playerdb {
     int requester;
     struct redis_reply reply;
+    struct um_builder queryb; // the UM_REDISQUERY
 };
 
 struct playerdb*
@@ -33,6 +34,7 @@ playerdb_create() {
 void
 playerdb_free(struct playerdb* self) {
     redis_finireply(&self->reply);
+    umb_fini(&self->queryb);
     free(self);
 }
 
@@ -69,39 +71,190 @@ _str_to_bytes(const char* str, int sz, uint8_t* bytes, int nbyte) {
 }
 */
 
+static inline struct UM_REDISQUERY*
+_beginquery(struct playerdb* self) {
+    struct um_builder* b = &self->queryb;
+    umb_begin(b, IDUM_REDISQUERY, sizeof(struct UM_REDISQUERY));
+    umb_reserve(b, UM_MAXSZ - sizeof(struct UM_REDISQUERY));
+    return (void*)UMB_UM(b);
+}
+
+// rw is the writer of rq->data
 static inline int
-_sendto_db(struct UM_BASE* um, int sz) {
+_endquery(struct playerdb* self, struct memrw* rw) {
+    struct um_builder* b = &self->queryb;
+    b->sz += RW_CUR(rw);
     const struct sc_node* db = sc_node_get(HNODE_ID(NODE_RPUSER, 0));
     if (db) {
-        UM_SENDTONODE(db, um, sz);
+        UM_SENDBUILDER(db->connid, b);
         return 0;
     }
     return 1;
 }
 
 static int
-_offline_db(const char* sql, int sz) {
-    UM_DEFVAR(UM_REDISQUERY, rq);
+_offline_db(struct playerdb* self, const char* sql, int sz) {
+    struct UM_REDISQUERY* rq = _beginquery(self);
     rq->needreply = 0;
     rq->needrecord = 1;
     rq->cbsz = 0;
     struct memrw rw;
-    memrw_init(&rw, rq->data, rq->msgsz - sizeof(*rq));
+    memrw_init(&rw, rq->data, self->queryb.cap - sizeof(*rq));
     memrw_write(&rw, sql, sz); 
-    rq->msgsz = sizeof(*rq) + RW_CUR(&rw);
-    return _sendto_db((void*)rq, rq->msgsz);
+    return _endquery(self, &rw);
 }
 
+/*
+ * the chardata is saved as one binary value in hash field "data" of user:<charid>,
+ * the old layout (one text field per member) is still read if no "data",
+ * and then converted once at load.
+ * binary value is host byte order, packed as the messages:
+ * struct chardata_blob, ringpage[npage], ringobj[nring]
+ */
+#define CHARDATA_VERSION 1
+
+#pragma pack(1)
+struct chardata_blob {
+    uint8_t  version;
+    uint16_t level;
+    uint32_t exp;
+    uint32_t coin;
+    uint32_t diamond;
+    uint16_t package;
+    uint32_t role;
+    uint32_t skin;
+    uint32_t score_normal;
+    uint32_t score_dashi;
+    uint8_t  ownrole[ROLE_MAX];
+    uint8_t  usepage;
+    uint8_t  npage;
+    uint8_t  nring;
+};
+#pragma pack()
+
+// the legacy text fields, deleted after migrate
+#define LEGACY_FIELDS \
+    " level exp coin diamond package role skin score1 score2" \
+    " ownrole usepage npage pages nring rings"
+
 static int
-_db(struct player* p, int8_t type) {
-    struct chardata* cdata = &p->data;
+_blob_size(const struct chardata* cdata) {
+    const struct ringdata* rdata = &cdata->ringdata;
+    int npage = min(rdata->npage, RING_PAGE_MAX);
+    int nring = min(rdata->nring, RING_MAX);
+    return sizeof(struct chardata_blob) + 
+        npage * sizeof(struct ringpage) + 
+        nring * sizeof(struct ringobj);
+}
+
+static int
+_blob_encode(const struct chardata* cdata, struct memrw* rw) {
+    const struct ringdata* rdata = &cdata->ringdata;
+    int npage = min(rdata->npage, RING_PAGE_MAX);
+    int nring = min(rdata->nring, RING_MAX);
+    if (RW_SPACE(rw) < _blob_size(cdata))
+        return 1;
+    struct chardata_blob* b = (void*)rw->ptr;
+    b->version = CHARDATA_VERSION;
+    b->level = cdata->level;
+    b->exp = cdata->exp;
+    b->coin = cdata->coin;
+    b->diamond = cdata->diamond;
+    b->package = cdata->package;
+    b->role = cdata->role;
+    b->skin = cdata->skin;
+    b->score_normal = cdata->score_normal;
+    b->score_dashi = cdata->score_dashi;
+    memcpy(b->ownrole, cdata->ownrole, sizeof(b->ownrole));
+    b->usepage = rdata->usepage;
+    b->npage = npage;
+    b->nring = nring;
+    memrw_pos(rw, sizeof(*b));
+    memrw_write(rw, rdata->pages, npage * sizeof(struct ringpage));
+    memrw_write(rw, rdata->rings, nring * sizeof(struct ringobj));
+    return 0;
+}
+
+// decode from the reply buffer in place
+static int
+_blob_decode(struct chardata* cdata, const char* ptr, int sz) {
+    if (sz < (int)sizeof(struct chardata_blob))
+        return SERR_DBDATAERR;
+    const struct chardata_blob* b = (const void*)ptr;
+    if (b->version != CHARDATA_VERSION)
+        return SERR_DBDATAERR;
+    if (b->npage > RING_PAGE_MAX ||
+        b->nring > RING_MAX)
+        return SERR_DBDATAERR;
+    int pagesz = b->npage * sizeof(struct ringpage);
+    int ringsz = b->nring * sizeof(struct ringobj);
+    if (sz != (int)sizeof(*b) + pagesz + ringsz)
+        return SERR_DBDATAERR;
+
     struct ringdata* rdata = &cdata->ringdata;
+    cdata->level = b->level;
+    cdata->exp = b->exp;
+    cdata->coin = b->coin;
+    cdata->diamond = b->diamond;
+    cdata->package = b->package;
+    cdata->role = b->role;
+    cdata->skin = b->skin;
+    cdata->score_normal = b->score_normal;
+    cdata->score_dashi = b->score_dashi;
+    memcpy(cdata->ownrole, b->ownrole, sizeof(cdata->ownrole));
+    rdata->usepage = b->usepage;
+    rdata->npage = b->npage;
+    rdata->nring = b->nring;
+    ptr += sizeof(*b);
+    memcpy(rdata->pages, ptr, pagesz);
+    memcpy(rdata->rings, ptr + pagesz, ringsz);
+    return SERR_OK;
+}
+
+// multibulk request, binary safe
+static inline void
+_bulk_count(struct memrw* rw, int n) {
+    int len = snprintf(rw->ptr, RW_SPACE(rw), "*%d\r\n", n);
+    memrw_pos(rw, len);
+}
+
+static inline void
+_bulk_head(struct memrw* rw, int sz) {
+    int len = snprintf(rw->ptr, RW_SPACE(rw), "$%d\r\n", sz);
+    memrw_pos(rw, len);
+}
+
+static inline void
+_bulk_arg(struct memrw* rw, const void* data, int sz) {
+    _bulk_head(rw, sz);
+    memrw_write(rw, data, sz);
+    memrw_write(rw, "\r\n", 2);
+}
+
+static inline void
+_bulk_str(struct memrw* rw, const char* str) {
+    _bulk_arg(rw, str, strlen(str));
+}
+
+static int
+_bulk_data(struct memrw* rw, const struct chardata* cdata) {
+    _bulk_str(rw, "data");
+    _bulk_head(rw, _blob_size(cdata));
+    if (_blob_encode(cdata, rw))
+        return 1;
+    memrw_write(rw, "\r\n", 2);
+    return 0;
+}
+
+static int
+_db(struct playerdb* self, struct player* p, int8_t type) {
+    struct chardata* cdata = &p->data;
 
-    UM_DEFVAR(UM_REDISQUERY, rq);
+    struct UM_REDISQUERY* rq = _beginquery(self);
     rq->needreply = 0;
     rq->needrecord = 0;
     struct memrw rw;
-    memrw_init(&rw, rq->data, rq->msgsz - sizeof(*rq));
+    memrw_init(&rw, rq->data, self->queryb.cap - sizeof(*rq));
     memrw_write(&rw, &type, sizeof(type)); 
     memrw_write(&rw, &p->gid, sizeof(p->gid));
     memrw_write(&rw, &p->cid, sizeof(p->cid));
@@ -149,21 +302,8 @@ _db(struct player* p, int8_t type) {
         rq->cbsz = RW_CUR(&rw);
         int len = snprintf(rw.ptr, RW_SPACE(&rw), "hmget user:%u"
                 " name"
-                " level"
-                " exp"
-                " coin"
-                " diamond"
-                " package"
-                " role"
-                " skin"
-                " score1"
-                " score2"
-                " ownrole"
-                " usepage"
-                " npage"
-                " pages"
-                " nring"
-                " rings"
+                " data"
+                LEGACY_FIELDS
                 "\r\n", charid);
         memrw_pos(&rw, len);
         }
@@ -175,25 +315,15 @@ _db(struct player* p, int8_t type) {
         rq->cbsz = RW_CUR(&rw);
         cdata->coin = 1000000; // todo
         cdata->diamond = 100000; // todo
-        int len = snprintf(rw.ptr, RW_SPACE(&rw), "hmset user:%u"
-                " name %s"
-                " level %u"
-                " exp %u"
-                " coin %u"
-                " diamond %u"
-                " package %u"
-                " role %u"
-                " skin %u"
-                "\r\n", charid,
-                cdata->name,
-                cdata->level, 
-                cdata->exp, 
-                cdata->coin, 
-                cdata->diamond, 
-                cdata->package,
-                cdata->role,
-                cdata->skin);
-        memrw_pos(&rw, len);
+        char key[32];
+        snprintf(key, sizeof(key), "user:%u", charid);
+        _bulk_count(&rw, 6);
+        _bulk_str(&rw, "hmset");
+        _bulk_str(&rw, key);
+        _bulk_str(&rw, "name");
+        _bulk_str(&rw, cdata->name);
+        if (_bulk_data(&rw, cdata))
+            return 1;
         }
         break;
     case PDB_BINDCHARID: {
@@ -213,79 +343,45 @@ _db(struct player* p, int8_t type) {
         uint32_t charid = cdata->charid;
         memrw_write(&rw, &charid, sizeof(charid));
         rq->cbsz = RW_CUR(&rw);
-
-        char strownrole[sc_bytestr_encode_leastn(sizeof(cdata->ownrole))];
-        sc_bytestr_encode((uint8_t*)cdata->ownrole, sizeof(cdata->ownrole), 
-                          strownrole, sizeof(strownrole));
-        char strpages[sc_bytestr_encode_leastn(sizeof(rdata->pages))];
-        sc_bytestr_encode((uint8_t*)rdata->pages, min(rdata->npage, sizeof(rdata->pages)), 
-                          strpages, sizeof(strpages));
-        char strrings[sc_bytestr_encode_leastn(sizeof(rdata->rings))];
-        sc_bytestr_encode((uint8_t*)rdata->rings, min(rdata->nring, sizeof(rdata->rings)), 
-                          strrings, sizeof(strrings));
-        int len = snprintf(rw.ptr, RW_SPACE(&rw), "hmset user:%u"
-                " level %u"
-                " exp %u"
-                " coin %u"
-                " diamond %u"
-                " package %u"
-                " role %u"
-                " skin %u"
-                " score1 %u"
-                " score2 %u"
-                " ownrole %s"
-                " usepage %u"
-                " npage %u"
-                " pages %s"
-                " nring %u"
-                " rings %s"
-                "\r\n", charid,
-                cdata->level, 
-                cdata->exp, 
-                cdata->coin, 
-                cdata->diamond, 
-                cdata->package,
-                cdata->role,
-                cdata->skin,
-                cdata->score_normal,
-                cdata->score_dashi,
-                strownrole,
-                rdata->usepage,
-                rdata->npage,
-                strpages,
-                rdata->nring,
-                "strrings" // todo
-                );
+        char key[32];
+        snprintf(key, sizeof(key), "user:%u", charid);
+        _bulk_count(&rw, 4);
+        _bulk_str(&rw, "hset");
+        _bulk_str(&rw, key);
+        if (_bulk_data(&rw, cdata))
+            return 1;
+        }
+        break;
+    case PDB_MIGRATE: {
+        rq->needreply = 0;
+        rq->needrecord = 1;
+        uint32_t charid = cdata->charid;
+        memrw_write(&rw, &charid, sizeof(charid));
+        rq->cbsz = RW_CUR(&rw);
+        char key[32];
+        snprintf(key, sizeof(key), "user:%u", charid);
+        _bulk_count(&rw, 4);
+        _bulk_str(&rw, "hset");
+        _bulk_str(&rw, key);
+        if (_bulk_data(&rw, cdata))
+            return 1;
+        // pipeline the delete in the same request, route by the same key
+        int len = snprintf(rw.ptr, RW_SPACE(&rw), "hdel %s"
+                LEGACY_FIELDS
+                "\r\n", key);
         memrw_pos(&rw, len);
         }
         break;
     default:
         return 1;
     }
-    rq->msgsz = sizeof(*rq) + RW_CUR(&rw);
-    return _sendto_db((void*)rq, rq->msgsz);
+    return _endquery(self, &rw);
 }
 
 static int
-_loadpdb(struct player* p, struct redis_replyitem* item) {
+_loadlegacy(struct chardata* cdata, struct redis_replyitem* si, struct redis_replyitem* end) {
 #define CHECK(x) if (si < end) {x; } else { return SERR_OK; }
-    
-    struct chardata* cdata = &p->data;
-    uint32_t charid = cdata->charid;
-    uint32_t accid  = cdata->accid;
-    memset(cdata, 0, sizeof(*cdata));
-    cdata->charid = charid;
-    cdata->accid = accid;
-
     struct ringdata* rdata = &cdata->ringdata;
-    struct redis_replyitem* si = item->child;
-    struct redis_replyitem* end = si + item->value.i; 
-    CHECK(
-    if (strncpychk(cdata->name, sizeof(cdata->name), si->value.p, si->value.len)) {
-        return SERR_DBDATAERR; // maybe no char, this is a empty item, all value is "-1"
-    }
-    si++;
-    )
     CHECK(cdata->level = redis_bulkitem_toul(si++));
     CHECK(cdata->exp = redis_bulkitem_toul(si++));
     CHECK(cdata->coin = redis_bulkitem_toul(si++));
@@ -310,16 +406,46 @@ _loadpdb(struct player* p, struct redis_replyitem* item) {
     si++;
     );
     return SERR_OK;
+#undef CHECK
+}
+
+// *legacy set to 1 if load from the old field layout
+static int
+_loadpdb(struct player* p, struct redis_replyitem* item, int* legacy) {
+    struct chardata* cdata = &p->data;
+    uint32_t charid = cdata->charid;
+    uint32_t accid  = cdata->accid;
+    memset(cdata, 0, sizeof(*cdata));
+    cdata->charid = charid;
+    cdata->accid = accid;
+
+    *legacy = 0;
+    struct redis_replyitem* si = item->child;
+    struct redis_replyitem* end = si + item->value.i; 
+    if (end - si < 2) {
+        return SERR_DBDATAERR;
+    }
+    if (strncpychk(cdata->name, sizeof(cdata->name), si->value.p, si->value.len)) {
+        return SERR_DBDATAERR; // maybe no char, this is a empty item, all value is "-1"
+    }
+    si++;
+    if (!redis_bulkitem_isnull(si)) {
+        return _blob_decode(cdata, si->value.p, si->value.len);
+    }
+    si++;
+    *legacy = 1;
+    return _loadlegacy(cdata, si, end);
 }
 
 void
 playerdb_service(struct service* s, struct service_message* sm) {
+    struct playerdb* self = SERVICE_SELF;
     if (sm->source == DB_PLAYER) {
         struct player* p = sm->msg;
-        sm->result = (void*)(ptrdiff_t)_db(p, sm->type);
+        sm->result = (void*)(ptrdiff_t)_db(self, p, sm->type);
     } else {
         const char* sql = sm->msg;
-        sm->result = (void*)(ptrdiff_t)_offline_db(sql, sm->sz);
+        sm->result = (void*)(ptrdiff_t)_offline_db(self, sql, sm->sz);
     }
 }
 
@@ -338,7 +464,7 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
     uint16_t gid = 0;
     uint16_t cid = 0;
     struct memrw rw;
-    memrw_init(&rw, rep->data, rep->msgsz - sizeof(*rep));
+    memrw_init(&rw, rep->data, nm->sz - sizeof(*rep));
     memrw_read(&rw, &type, sizeof(type));
     memrw_read(&rw, &gid, sizeof(gid));
     memrw_read(&rw, &cid, sizeof(cid));
@@ -377,7 +503,7 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
             break;
         }
         p->status = PS_LOADCHAR;
-        _db(p, PDB_LOAD);
+        _db(self, p, PDB_LOAD);
         return;
         }
         break;
@@ -409,7 +535,7 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
             break;
         }
         p->status = PS_SAVECHARNAME;
-        _db(p, PDB_SAVENAME);
+        _db(self, p, PDB_SAVENAME);
         return;
         }
         break;
@@ -427,7 +553,7 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
         struct redis_replyitem* item = self->reply.stack[0];
         if (item->type == REDIS_REPLY_STATUS) {
             p->status = PS_CHARUNIQUEID;
-            _db(p, PDB_CHARID);
+            _db(self, p, PDB_CHARID);
             return;
         } else if (item->type == REDIS_REPLY_ERROR) {
             serr = SERR_DBERR;
@@ -462,7 +588,7 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
             break;
         }
         p->status = PS_CREATECHAR;
-        _db(p, PDB_CREATE);
+        _db(self, p, PDB_CREATE);
         return;
         }
         break;
@@ -480,7 +606,7 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
         struct redis_replyitem* item = self->reply.stack[0];
         if (item->type == REDIS_REPLY_STATUS) {
             p->status = PS_BINDCHARID;
-            _db(p, PDB_BINDCHARID);
+            _db(self, p, PDB_BINDCHARID);
             return;
         } else if (item->type == REDIS_REPLY_ERROR) {
             serr = SERR_DBERR;
@@ -527,9 +653,13 @@ _handle_redis(struct playerdb* self, struct node_message* nm) {
             serr = SERR_DBREPLYTYPE;
             break;
         }
-        serr = _loadpdb(p, item);
+        int legacy;
+        serr = _loadpdb(p, item, &legacy);
         if (serr == SERR_OK) {
             p->status = PS_LOGIN;
+            if (legacy) {
+                _db(self, p, PDB_MIGRATE);
+            }
         }
         }
         break;
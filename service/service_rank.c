@@ -192,7 +192,7 @@ _handle_redis(struct rank* self, struct node_message* nm) {
     UM_CAST(UM_REDISREPLY, rep, nm->um);
         
     struct memrw rw;
-    memrw_init(&rw, rep->data, rep->msgsz - sizeof(*rep));
+    memrw_init(&rw, rep->data, nm->sz - sizeof(*rep));
     uint8_t len; 
     memrw_read(&rw, &len, sizeof(len));
     char type[(int)len+1];
@@ -5,6 +5,8 @@
 #include "sc_timer.h"
 #include "sc_log.h"
 #include "sc_net.h"
+#include "sc_reactor.h"
+#include "sc_util.h"
 #include "user_message.h"
 #include "client_type.h"
 #include "redis.h"
@@ -13,8 +15,19 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdio.h>
 #include <assert.h>
 
+/*
+ * a pool of redis connections, the query route by the key hash,
+ * so the queries of one key keep order in one connection.
+ * queries arrive in one loop are batched, and write once per connection
+ */
+
+#define CONN_MAX 32
+#define QUERY_CBMAX 256
+#define REPLY_BUFMAX (UM_LARGE_MAXSZ/2) // one reply, grow from 16K
+
 struct querylink {
     struct querylink* next;
     uint16_t nodeid;
@@ -27,14 +40,26 @@ struct queryqueue {
     FREELIST(querylink);
 };
 
-struct redisproxy {
+struct redisconn {
     int connid;
-    bool authed;
     struct redis_reply reply;
     struct queryqueue queryq;
+    int npending;
+    char* wbuf;
+    int wsz;
+    int wcap;
+};
+
+struct redisproxy {
+    int serviceid;
+    int nconn;
+    struct redisconn* conns;
+    int connecting; // the conn index wait for connect
+    bool flushing;
     int maxcount;
     int allcount;
     int times;
+    struct um_builder replyb; // the UM_REDISREPLY
 };
 
 struct redisproxy*
@@ -46,17 +71,26 @@ redisproxy_create() {
 
 void
 redisproxy_free(struct redisproxy* self) {
-    redis_finireply(&self->reply);
-    FREELIST_FINI(querylink, &self->queryq);
+    int i;
+    for (i=0; i<self->nconn; ++i) {
+        struct redisconn* c = &self->conns[i];
+        redis_finireply(&c->reply);
+        FREELIST_FINI(querylink, &c->queryq);
+        free(c->wbuf);
+    }
+    free(self->conns);
+    umb_fini(&self->replyb);
     free(self);
 }
 
 static int
-_connect_redis(struct service* s, bool block) {
+_connect_redis(struct redisproxy* self, int index, bool block) {
     const char* addr = sc_getstr("redis_ip", "");
     int port = sc_getint("redis_port", 0);
-    sc_info("connect to redis %s:%u ...", addr, port);
-    if (sc_net_connect(addr, port, block, s->serviceid, CLI_REDIS)) { 
+    sc_info("connect to redis %s:%u [%d] ...", addr, port, index);
+    self->connecting = index;
+    if (sc_net_connect(addr, port, block, self->serviceid, CLI_REDIS)) {
+        self->connecting = -1;
         return 1;
     }
     return 0;
@@ -65,58 +99,132 @@ _connect_redis(struct service* s, bool block) {
 int
 redisproxy_init(struct service* s) {
     struct redisproxy* self = SERVICE_SELF;
-    self->connid = -1;
-    
-    if (_connect_redis(s, true)) {
-        return 1;
-    } 
-    redis_initreply(&self->reply, 512, 16*1024);
-    FREELIST_INIT(&self->queryq);
-
+    self->serviceid = s->serviceid;
+    self->connecting = -1;
+    int nconn = sc_getint("redis_connmax", 1);
+    if (nconn < 1)
+        nconn = 1;
+    if (nconn > CONN_MAX)
+        nconn = CONN_MAX;
+    self->nconn = nconn;
+    self->conns = malloc(sizeof(struct redisconn) * nconn);
+    memset(self->conns, 0, sizeof(struct redisconn) * nconn);
+    int i;
+    for (i=0; i<nconn; ++i) {
+        struct redisconn* c = &self->conns[i];
+        c->connid = -1;
+        redis_initreply(&c->reply, 512, 16*1024);
+        FREELIST_INIT(&c->queryq);
+    }
+    for (i=0; i<nconn; ++i) {
+        if (_connect_redis(self, i, true)) {
+            return 1;
+        }
+    }
     SUBSCRIBE_MSG(s->serviceid, IDUM_REDISQUERY);
     sc_timer_register(s->serviceid, 1000);
     return 0;
 }
 
-static inline void
-_query_to_redis(struct redisproxy* self, char* ptr, int sz) {
-    if (self->connid != -1) {
-        sc_net_send(self->connid, ptr, sz);
-    } else {
-        ptr[sz-1] = '\0';
-        sc_rec(ptr);
+static struct redisconn*
+_getconn(struct redisproxy* self, int connid) {
+    int i;
+    for (i=0; i<self->nconn; ++i) {
+        if (self->conns[i].connid == connid)
+            return &self->conns[i];
+    }
+    return NULL;
+}
+
+static struct redisconn*
+_routeconn(struct redisproxy* self, const char* key, int keysz) {
+    uint32_t h = 2166136261u;
+    int i;
+    for (i=0; i<keysz; ++i) {
+        h = (h ^ (uint8_t)key[i]) * 16777619u;
+    }
+    int start = h % self->nconn;
+    for (i=0; i<self->nconn; ++i) {
+        struct redisconn* c = &self->conns[(start+i) % self->nconn];
+        if (c->connid != -1)
+            return c;
+    }
+    return NULL;
+}
+
+static void
+_flush(void* ud) {
+    struct redisproxy* self = ud;
+    self->flushing = false;
+    int i;
+    for (i=0; i<self->nconn; ++i) {
+        struct redisconn* c = &self->conns[i];
+        if (c->wsz > 0) {
+            int sz = c->wsz;
+            c->wsz = 0;
+            if (c->connid != -1) {
+                sc_net_send(c->connid, c->wbuf, sz);
+            }
+        }
+    }
+}
+
+static void
+_batch(struct redisproxy* self, struct redisconn* c, const char* ptr, int sz) {
+    if (c->wsz + sz > c->wcap) {
+        int cap = c->wcap ? c->wcap : 4096;
+        while (cap < c->wsz + sz)
+            cap *= 2;
+        c->wbuf = realloc(c->wbuf, cap);
+        c->wcap = cap;
+    }
+    memcpy(c->wbuf + c->wsz, ptr, sz);
+    c->wsz += sz;
+    if (!self->flushing) {
+        self->flushing = true;
+        sc_reactor_defer(_flush, self);
     }
 }
 
 static void
-_query(struct redisproxy* self, int id, struct UM_BASE* um) {
+_query(struct redisproxy* self, int id, struct UM_BASE* um, int sz) {
     UM_CAST(UM_REDISQUERY, rq, um);
-    int datasz = (int)rq->msgsz - (int)sizeof(*rq) - (int)rq->cbsz;
+    int datasz = sz - (int)sizeof(*rq) - (int)rq->cbsz;
     if (datasz < 3) {
         return; // need 3 bytes at least
     }
     int cbsz = rq->cbsz;
+    if (cbsz > QUERY_CBMAX) {
+        sc_error("redis query callback too large: %d", cbsz);
+        return;
+    }
     char* dataptr = rq->data + cbsz;
-    int lastpos = 0; 
-    int n = 0;
-    int i;
-    for (i=0; i<datasz-1;) {
-        if (memcmp(&dataptr[i], "\r\n", 2) == 0) {
-            n++;
-            i+=2;
-            lastpos = i;
-        } else {
-            i++;
-        }
+    const char* key;
+    int keysz;
+    int n = redis_scanrequest(dataptr, datasz, &key, &keysz);
+    if (n <= 0) {
+        return; // need complete command
     }
-    if (lastpos != datasz) {
-        return; // need endswith \r\n
+    // the whole request route by the first key, so a MULTI ... EXEC
+    // and the replies of one request keep together
+    struct redisconn* c = _routeconn(self, key, keysz);
+    if (c == NULL) {
+        if (rq->needrecord) {
+            if (dataptr[0] == '*') {
+                // multibulk maybe binary, record the key only
+                sc_rec("lost query: key %.*s, size %d", keysz, key, datasz);
+            } else {
+                sc_rec("%.*s", datasz-2, dataptr);
+            }
+        }
+        return;
     }
     char* cbptr = rq->data;
+    int i;
     for (i=0; i<n; ++i) {
-        struct querylink* ql = FREELIST_PUSH(querylink, 
-                                             &self->queryq, 
-                                             sizeof(struct querylink) + cbsz);
+        struct querylink* ql = FREELIST_PUSH(querylink,
+                                             &c->queryq,
+                                             sizeof(struct querylink) + QUERY_CBMAX);
         ql->nodeid = rq->nodeid;
         ql->needreply = rq->needreply;
         ql->cbsz = cbsz;
@@ -124,14 +232,8 @@ _query(struct redisproxy* self, int id, struct UM_BASE* um) {
             memcpy(ql->cb, cbptr, cbsz);
         }
     }
-    if (self->connid != -1) {
-        sc_net_send(self->connid, dataptr, datasz);
-    } else {
-        if (rq->needrecord) {
-            dataptr[datasz-1] = '\0';
-            sc_rec(dataptr);
-        }
-    }
+    c->npending += n;
+    _batch(self, c, dataptr, datasz);
 }
 
 void
@@ -140,17 +242,18 @@ redisproxy_nodemsg(struct service* s, int id, void* msg, int sz) {
     UM_CAST(UM_BASE, um, msg);
     switch (um->msgid) {
     case IDUM_REDISQUERY:
-        _query(self, id, um);
+        _query(self, id, um, sz);
         break;
     }
 }
 
 static void
-_handlereply(struct redisproxy* self) {
-    //redis_walkreply(&self->reply); // todo: delete
+_handlereply(struct redisproxy* self, struct redisconn* c) {
+    //redis_walkreply(&c->reply); // todo: delete
 
-    struct querylink* ql = FREELIST_POP(querylink, &self->queryq);
+    struct querylink* ql = FREELIST_POP(querylink, &c->queryq);
     assert(ql);
+    c->npending--;
     if (ql->needreply == 0) {
         return; // no need reply
     }
@@ -158,34 +261,47 @@ _handlereply(struct redisproxy* self) {
     if (node == NULL) {
         return; // the node disconnect
     }
-    UM_DEFVAR(UM_REDISREPLY, rep);
+    struct um_builder* b = &self->replyb;
+    struct UM_REDISREPLY* rep = umb_begin(b, IDUM_REDISREPLY, sizeof(*rep));
     rep->cbsz = ql->cbsz;
-   
-    struct redis_reader* reader = &self->reply.reader;
-    struct memrw rw;
-    memrw_init(&rw, rep->data, rep->msgsz - sizeof(*rep));
+
+    struct redis_reader* reader = &c->reply.reader;
     if (ql->cbsz) {
-        memrw_write(&rw, ql->cb, ql->cbsz);
+        umb_write(b, ql->cb, ql->cbsz);
+    }
+    // the replies before this one are still in the buffer, start at pos_last
+    int sz = reader->pos - reader->pos_last;
+    if (umb_write(b, reader->buf + reader->pos_last, sz) < 0) {
+        sc_error("redis reply too large: %d", sz);
+        // reply an error instead, so the requester still get its cb
+        static const char err[] = "-ERR reply too large\r\n";
+        rep = umb_begin(b, IDUM_REDISREPLY, sizeof(*rep));
+        rep->cbsz = ql->cbsz;
+        if (ql->cbsz) {
+            umb_write(b, ql->cb, ql->cbsz);
+        }
+        umb_write(b, err, sizeof(err)-1);
     }
-    memrw_write(&rw, reader->buf, reader->pos);
-    rep->msgsz = RW_CUR(&rw) + sizeof(*rep);
-    UM_SENDTONODE(node, rep, rep->msgsz);
+    UM_SENDBUILDER(node->connid, b);
 }
 
 static void
-_read(struct redisproxy* self, struct net_message* nm) {
+_read(struct redisproxy* self, struct redisconn* c, struct net_message* nm) {
     assert(nm->ut == CLI_REDIS);
-    assert(nm->connid == self->connid);
     int id = nm->connid;
     int e = 0;
-    struct redis_reply* reply = &self->reply;
+    struct redis_reply* reply = &c->reply;
 
     for (;;) {
         void* buf = REDIS_REPLYBUF(reply);
         int space = REDIS_REPLYSPACE(reply);
         if (space <= 0) {
-            e = NET_ERR_NOBUF;
-            goto errout;
+            // one reply fill the buffer
+            if (redis_growreplybuf(reply, REPLY_BUFMAX)) {
+                e = NET_ERR_NOBUF;
+                goto errout;
+            }
+            continue;
         }
         int nread = sc_net_readto(id, buf, space, &e);
         if (nread <= 0) {
@@ -195,8 +311,8 @@ _read(struct redisproxy* self, struct net_message* nm) {
         int result = redis_getreply(reply);
         int K = 0;
         while (result == REDIS_SUCCEED) {
-            _handlereply(self);
-            redis_resetreply(reply); 
+            _handlereply(self, c);
+            redis_resetreply(reply);
             result = redis_getreply(reply);
             K++;
         }
@@ -215,7 +331,7 @@ _read(struct redisproxy* self, struct net_message* nm) {
             break; // net read over
         }
     }
-    return; 
+    return;
 errout:
     if (e) {
         sc_net_close_socket(id, true);
@@ -225,31 +341,47 @@ errout:
     }
 }
 
-//static int
-//_auth(struct redisproxy* self) {
-    //return 1;    
-//}
+static void
+_disconnect(struct redisconn* c) {
+    c->connid = -1;
+    c->npending = 0;
+    c->wsz = 0;
+    FREELIST_POPALL(querylink, &c->queryq);
+    // drop the partial reply, the reader is reset after each read
+    c->reply.reader.sz = 0;
+}
 
 void
 redisproxy_net(struct service* s, struct net_message* nm) {
     struct redisproxy* self = SERVICE_SELF;
+    struct redisconn* c;
     switch (nm->type) {
     case NETE_READ:
-        _read(self, nm);
+        c = _getconn(self, nm->connid);
+        if (c) {
+            _read(self, c, nm);
+        }
         break;
     case NETE_CONNECT:
-        self->connid = nm->connid;
-        sc_net_subscribe(nm->connid, true);
-        sc_info("connect to redis ok");
+        if (self->connecting >= 0) {
+            c = &self->conns[self->connecting];
+            self->connecting = -1;
+            c->connid = nm->connid;
+            sc_net_subscribe(nm->connid, true);
+            sc_info("connect to redis ok");
+        } else {
+            sc_net_close_socket(nm->connid, true);
+        }
         break;
     case NETE_CONNERR:
-        self->connid = -1;
-        FREELIST_POPALL(querylink, &self->queryq);
-        sc_error("connect to redis fail: %s", sc_net_error(nm->error)); 
+        self->connecting = -1;
+        sc_error("connect to redis fail: %s", sc_net_error(nm->error));
         break;
     case NETE_SOCKERR:
-        self->connid = -1;
-        FREELIST_POPALL(querylink, &self->queryq);
+        c = _getconn(self, nm->connid);
+        if (c) {
+            _disconnect(c);
+        }
         sc_error("redis disconnect: %s", sc_net_error(nm->error));
         break;
     }
@@ -258,10 +390,38 @@ redisproxy_net(struct service* s, struct net_message* nm) {
 void
 redisproxy_time(struct service* s) {
     struct redisproxy* self = SERVICE_SELF;
-    if (self->connid == -1) {
-        _connect_redis(s, false);
+    if (self->connecting == -1) {
+        int i;
+        for (i=0; i<self->nconn; ++i) {
+            if (self->conns[i].connid == -1) {
+                _connect_redis(self, i, false);
+                break;
+            }
+        }
+    }
+}
+
+// "STAT": write the stat text to sm->result (struct memrw)
+void
+redisproxy_service(struct service* s, struct service_message* sm) {
+    struct redisproxy* self = SERVICE_SELF;
+    if (sm->type != sc_cstr_to_int32("STAT") || sm->result == NULL)
+        return;
+    struct memrw* rw = sm->result;
+    int connected = 0;
+    int pending = 0;
+    int i;
+    for (i=0; i<self->nconn; ++i) {
+        if (self->conns[i].connid != -1)
+            connected++;
+        pending += self->conns[i].npending;
     }
-    if (self->times > 0) {
-        //sc_info("maxcount = %d, agvcount = %d", self->maxcount, self->allcount/self->times);
+    int n = snprintf(rw->ptr, RW_SPACE(rw),
+            "[conn %d/%d, pending %d, reply maxcount %d, allcount %d, avgcount %d]",
+            connected, self->nconn, pending,
+            self->maxcount, self->allcount,
+            self->times > 0 ? self->allcount/self->times : 0);
+    if (n > 0) {
+        memrw_pos(rw, n);
     }
 }
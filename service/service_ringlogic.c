@@ -148,7 +148,7 @@ _handle_equipring(struct ringlogic* self, struct player_message* pm) {
     }
     // do logic
     memcpy(page->slots, um->rings, sizeof(page->slots));
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    _dirtyplayer(p, PD_RINGS);
 }
 /*
 static void
@@ -181,7 +181,7 @@ _handle_renameringpage(struct ringlogic* self, struct player_message* pm) {
     // do logic
     strncpy(page->name, um->name, sizeof(page->name));
     
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    _dirtyplayer(p, PD_RINGS);
 }
 
 static void
@@ -205,7 +205,7 @@ _handle_buyringpage(struct ringlogic* self, struct player_message* pm) {
     
     _sync_money(p);
     _sync_ringpage(p); 
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    _dirtyplayer(p, PD_RINGS|PD_COIN);
     return;
 }
 
@@ -232,7 +232,7 @@ _handle_useringpage(struct ringlogic* self, struct player_message* pm) {
     struct service_message sm = { 0, 0, 0, sizeof(p), p };
     service_notify_service(self->attrihandler, &sm);
 
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    _dirtyplayer(p, PD_RINGS);
     return;
 }
 
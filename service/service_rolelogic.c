@@ -130,7 +130,7 @@ _handle_userole(struct rolelogic* self, struct player_message* pm) {
     service_notify_service(self->attrihandler, &sm);
 
     _sync_role(p); 
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    _dirtyplayer(p, PD_ROLES);
 }
 
 static void
@@ -168,7 +168,7 @@ _handle_buyrole(struct rolelogic* self, struct player_message* pm) {
     cdata->diamond -= tplt->needdiamond;
     _sync_addrole(p, roleid);
     _sync_money(p);
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    _dirtyplayer(p, PD_ROLES|PD_COIN);
     return;
 }
 
@@ -199,10 +199,12 @@ _onlogin(struct player* p) {
         cdata->role != ROLE_DEF) {
         cdata->role = ROLE_DEF;
         tplt = tplt_find(TPLT_ROLE, cdata->role);
+        _dirtyplayer(p, PD_ROLES);
     }
     if (tplt) {
         if (!_hasrole(cdata, ROLE_DEF)) {
             _addrole(cdata, ROLE_DEF);
+            _dirtyplayer(p, PD_ROLES);
         }
         _userole(cdata, tplt);
     } else {
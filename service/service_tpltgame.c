@@ -1,6 +1,7 @@
 #include "sc_service.h"
 #include "sc_util.h"
 #include "sc_log.h"
+#include "sc_timer.h"
 #include "sc_util.h"
 #include "tplt_include.h"
 #include "tplt_struct.h"
@@ -11,20 +12,36 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+ * "TPLT" reload builds a new version in a thread, the loop polls for it,
+ * then publishes the tplt and swaps the maps, rooms hold the old tplt
+ * by tplt_acquire until they end
+ */
+
+struct version {
+    struct tplt* tplt;
+    struct idmap* maps;
+    int error;
+};
 
 struct tpltgame {
     struct idmap* maps;
+    struct version* loading; // owned by the load thread until done
+    int done;
+    int64_t timer;
 };
 
-static int
-_loadtplt() {
-    tplt_fini();
+static struct tplt*
+_buildtplt() {
 #define TBLFILE(name) "./res/tbl/"#name".tbl"
     struct tplt_desc desc[] = {
-        { TPLT_ITEM, sizeof(struct item_tplt), 1, TBLFILE(item), 0, TPLT_VIST_VEC32},
-        { TPLT_MAP,  sizeof(struct map_tplt),  1, TBLFILE(map),  0, TPLT_VIST_VEC32},
+        { TPLT_ITEM, sizeof(struct item_tplt), 1, TBLFILE(item), 0, TPLT_VIST_AUTO},
+        { TPLT_MAP,  sizeof(struct map_tplt),  1, TBLFILE(map),  0, TPLT_VIST_AUTO},
     };
-    return tplt_init(desc, sizeof(desc)/sizeof(desc[0]));
+    return tplt_build(desc, sizeof(desc)/sizeof(desc[0]));
 }
 
 static void
@@ -33,18 +50,14 @@ _freemapcb(void* value) {
     roommap_free(m);
 }
 
-static int
-_loadmap(struct tpltgame* self) {
-    const struct tplt_holder* holder = tplt_get_holder(TPLT_MAP);
+static struct idmap*
+_buildmap(const struct tplt* t) {
+    const struct tplt_holder* holder = tplt_vholder(t, TPLT_MAP);
     if (holder == NULL)
-        return 1;
+        return NULL;
     
     int sz = TPLT_HOLDER_NELEM(holder);
-    if (self->maps) {
-        idmap_free(self->maps, _freemapcb);
-        self->maps = NULL;
-    } 
-    self->maps = idmap_create(sz);
+    struct idmap* maps = idmap_create(sz);
    
     char fname[PATH_MAX];
     const struct map_tplt* tplt = TPLT_HOLDER_FIRSTELEM(map_tplt, holder);
@@ -55,38 +68,128 @@ _loadmap(struct tpltgame* self) {
         struct roommap* m = roommap_create(fname);
         if (m == NULL) {
             sc_error("load map fail");
-            return 1;
+            idmap_free(maps, _freemapcb);
+            return NULL;
         }
-        idmap_insert(self->maps, tplt[i].id, m);
+        idmap_insert(maps, tplt[i].id, m);
     }
-    return 0;
+    return maps;
+}
+
+static void
+_build(struct version* v) {
+    v->tplt = _buildtplt();
+    if (v->tplt == NULL) {
+        v->error = 1;
+        return;
+    }
+    v->maps = _buildmap(v->tplt);
+    if (v->maps == NULL) {
+        tplt_release(v->tplt);
+        v->tplt = NULL;
+        v->error = 1;
+    }
+}
+
+static void
+_publish(struct tpltgame* self, struct version* v) {
+    tplt_publish(v->tplt);
+    if (self->maps) {
+        idmap_free(self->maps, _freemapcb);
+    }
+    self->maps = v->maps;
+}
+
+static void*
+_loadthread(void* ud) {
+    struct tpltgame* self = ud;
+    _build(self->loading);
+    __atomic_store_n(&self->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void
+_pollload(void* ud) {
+    struct tpltgame* self = ud;
+    if (!__atomic_load_n(&self->done, __ATOMIC_ACQUIRE))
+        return;
+    struct version* v = self->loading;
+    if (v->error) {
+        sc_error("reload tplt fail, keep the current");
+    } else {
+        _publish(self, v);
+        sc_info("reload tplt ok");
+    }
+    free(v);
+    self->loading = NULL;
+    self->done = 0;
+    sc_timer_del(self->timer);
+    self->timer = -1;
+}
+
+static void
+_reload(struct tpltgame* self) {
+    if (self->loading) {
+        sc_info("reload tplt is in progress");
+        return;
+    }
+    struct version* v = malloc(sizeof(*v));
+    memset(v, 0, sizeof(*v));
+    self->loading = v;
+    self->done = 0;
+    pthread_t pid;
+    if (pthread_create(&pid, NULL, _loadthread, self)) {
+        sc_error("reload tplt thread create fail");
+        free(v);
+        self->loading = NULL;
+        return;
+    }
+    pthread_detach(pid);
+    self->timer = sc_timer_add(100, 100, _pollload, self);
 }
 
 struct tpltgame*
 tpltgame_create() {
     struct tpltgame* self = malloc(sizeof(*self));
     memset(self, 0, sizeof(*self));
+    self->timer = -1;
     return self;
 }
 
 void
 tpltgame_free(struct tpltgame* self) {
+    if (self->loading) {
+        // wait the load thread, it is rare to free while reloading
+        while (!__atomic_load_n(&self->done, __ATOMIC_ACQUIRE))
+            usleep(1000);
+        struct version* v = self->loading;
+        if (v->tplt)
+            tplt_release(v->tplt);
+        if (v->maps)
+            idmap_free(v->maps, _freemapcb);
+        free(v);
+    }
+    if (self->timer != -1) {
+        sc_timer_del(self->timer);
+    }
     tplt_fini();
     if (self->maps) {
         idmap_free(self->maps, _freemapcb);
         self->maps = NULL;
     }
+    free(self);
 }
 
 int
 tpltgame_init(struct service* s) {
     struct tpltgame* self = SERVICE_SELF;
-    if (_loadtplt()) {
-        return 1;
-    }
-    if (_loadmap(self)) {
+    struct version v;
+    memset(&v, 0, sizeof(v));
+    _build(&v);
+    if (v.error) {
         return 1;
     }
+    _publish(self, &v);
     return 0;
 }
 
@@ -96,7 +199,6 @@ tpltgame_service(struct service* s, struct service_message* sm) {
     if (sc_cstr_compare_int32("GMAP", sm->type)) {
         sm->result = idmap_find(self->maps, sm->sessionid);
     } else if (sc_cstr_compare_int32("TPLT", sm->type)) {
-        _loadtplt();
-        _loadmap(self);
+        _reload(self);
     } 
 }
@@ -26,6 +26,8 @@ struct world {
     int rolehandler;
     int ringhandler;
     int attrihandler;
+    int save_interval; // second
+    int save_tick;
 };
 
 struct world*
@@ -35,10 +37,18 @@ world_create() {
     return self;
 }
 
+static void
+_saveplayer(struct player* p, void* ud) {
+    struct world* self = ud;
+    send_playerdb(self->dbhandler, p, PDB_SAVE);
+}
+
 void
 world_free(struct world* self) {
     if (self == NULL)
         return;
+    // write the dirty players, the services are freed before the net
+    _foreach_dirtyplayer(0, _saveplayer, self);
     _freeplayers();
     free(self);
 }
@@ -58,7 +68,9 @@ world_init(struct service* s) {
     int hmax = sc_getint("world_hmax_pergate", cmax);
     int gmax = sc_getint("world_gmax", 0);
     _allocplayers(cmax, hmax, gmax);
+    self->save_interval = sc_getint("world_save_interval", 60);
     SUBSCRIBE_MSG(s->serviceid, IDUM_FORWARD); 
+    SUBSCRIBE_MSG(s->serviceid, IDUM_FORWARDV);
 
     sc_timer_register(s->serviceid, 1000);
     return 0;
@@ -160,7 +172,9 @@ _createchar(struct world* self, const struct sc_node* node, int cid, struct UM_B
 
 static void
 _logout(struct world* self, struct player* p) {
-    send_playerdb(self->dbhandler, p, PDB_SAVE);
+    if (p->dirty) {
+        send_playerdb(self->dbhandler, p, PDB_SAVE);
+    }
     _freeplayer(p);
 }
 
@@ -200,12 +214,30 @@ world_nodemsg(struct service* s, int id, void* msg, int sz) {
     }
     switch (nm.hn->tid) {
     case NODE_GATE:
-        _handlegate(self, &nm);
+        if (nm.um->msgid == IDUM_FORWARDV) {
+            UM_CAST(UM_FORWARDV, fv, nm.um);
+            struct UM_FORWARDV_iter it;
+            struct UM_FORWARD* fw;
+            UM_FORWARDV_begin(fv, &it);
+            while ((fw = UM_FORWARDV_next(&it))) {
+                nm.um = (struct UM_BASE*)fw;
+                nm.sz = fw->msgsz;
+                _handlegate(self, &nm);
+            }
+        } else {
+            _handlegate(self, &nm);
+        }
         break;
     }
 }
 
 void
 world_time(struct service* s) {
-    //struct world* self= SERVICE_SELF;
+    struct world* self= SERVICE_SELF;
+    if (self->save_interval > 0 &&
+        ++self->save_tick >= self->save_interval) {
+        self->save_tick = 0;
+        // the saves in one loop are write once per connection by redisproxy
+        _foreach_dirtyplayer(0, _saveplayer, self);
+    }
 }
@@ -10,19 +10,48 @@
 struct tplt_one {
     struct tplt_holder* holder;
     struct tplt_visitor* visitor;
+    size_t mapsz; // 0 if holder is malloc
 };
 
 struct tplt {
+    int ref;
     int sz;
     struct tplt_one* p;
 };
 
+/*
+ * the current version, readers on the loop use it directly,
+ * who keep pointers across a publish (eg. room) must tplt_acquire one
+ */
 static struct tplt* self = NULL;
 
-int
-tplt_init(const struct tplt_desc* desc, int sz) {
+static void
+_free(struct tplt* t) {
+    struct tplt_one* one;
+    int i;
+    for (i=0; i<t->sz; ++i) {
+        one = &t->p[i];
+        if (one->visitor) {
+            tplt_visitor_free(one->visitor);
+        }
+        if (one->holder) {
+#ifndef _WIN32
+            if (one->mapsz > 0) {
+                tplt_holder_unmap(one->holder, one->mapsz);
+                continue;
+            }
+#endif
+            tplt_holder_free(one->holder);
+        }
+    }
+    free(t->p);
+    free(t);
+}
+
+struct tplt*
+tplt_build(const struct tplt_desc* desc, int sz) {
     if (sz <= 0)
-        return 1;
+        return NULL;
 
     int maxtype = 0;
     const struct tplt_desc* d;
@@ -35,68 +64,105 @@ tplt_init(const struct tplt_desc* desc, int sz) {
     } 
 
     maxtype += 1;
-    self = malloc(sizeof(*self));
-    self->sz = maxtype;
-    self->p = malloc(sizeof(struct tplt_one) * maxtype);
-    memset(self->p, 0, sizeof(struct tplt_one) * maxtype);
+    struct tplt* t = malloc(sizeof(*t));
+    t->ref = 1;
+    t->sz = maxtype;
+    t->p = malloc(sizeof(struct tplt_one) * maxtype);
+    memset(t->p, 0, sizeof(struct tplt_one) * maxtype);
  
-    struct tplt_holder* holder; 
-    struct tplt_visitor* visitor;
+    struct tplt_one* one;
     for (i=0; i<sz; ++i) {
         d = &desc[i];
         assert(d->stream);
         assert(d->type >= 0 && d->type < maxtype);
+        one = &t->p[d->type];
         if (d->isfromfile) {
             TPLT_LOGINFO("load tplt: %s", d->stream);
-            holder = tplt_holder_load(d->stream, d->size);
+#ifndef _WIN32
+            one->holder = tplt_holder_map(d->stream, d->size, &one->mapsz);
+#else
+            one->holder = tplt_holder_load(d->stream, d->size);
+#endif
         } else {
-            holder = tplt_holder_loadfromstream(d->stream, d->streamsz, d->size);
+            one->holder = tplt_holder_loadfromstream(d->stream, d->streamsz, d->size);
         }
-        if (holder == NULL) {
-            tplt_fini();
-            return 1;
+        if (one->holder == NULL) {
+            _free(t);
+            return NULL;
         }
         assert(d->vist);
-        visitor = tplt_visitor_create(d->vist, holder);
-        if (visitor == NULL) {
-            free(holder);
-            tplt_fini();
-            return 1;
+        one->visitor = tplt_visitor_create(d->vist, one->holder);
+        if (one->visitor == NULL) {
+            _free(t);
+            return NULL;
         }
-        self->p[d->type].holder = holder;
-        self->p[d->type].visitor = visitor;
+        struct tplt_visitor_stat st;
+        tplt_visitor_stat(one->visitor, &st);
+        TPLT_LOGINFO("tplt %d visitor: %s, nelem %d, slots %d", 
+                d->type, st.strategy, st.nelem, st.slots);
+    }
+    return t;
+}
+
+void
+tplt_publish(struct tplt* t) {
+    struct tplt* old = __atomic_exchange_n(&self, t, __ATOMIC_ACQ_REL);
+    if (old) {
+        tplt_release(old);
+    }
+}
+
+struct tplt*
+tplt_acquire() {
+    struct tplt* t = __atomic_load_n(&self, __ATOMIC_ACQUIRE);
+    if (t) {
+        __atomic_add_fetch(&t->ref, 1, __ATOMIC_RELAXED);
+    }
+    return t;
+}
+
+void
+tplt_release(struct tplt* t) {
+    if (__atomic_sub_fetch(&t->ref, 1, __ATOMIC_ACQ_REL) == 0) {
+        _free(t);
     }
+}
+
+int
+tplt_init(const struct tplt_desc* desc, int sz) {
+    struct tplt* t = tplt_build(desc, sz);
+    if (t == NULL)
+        return 1; // keep the current
+    tplt_publish(t);
     return 0;
 }
 
 void 
 tplt_fini() {
-    if (self == NULL)
-        return;
-    
-    struct tplt_one* one;
-    int i;
-    for (i=0; i<self->sz; ++i) {
-        one = &self->p[i];
-        if (one->holder) {
-            tplt_holder_free(one->holder);
-        }
-        if (one->visitor) {
-            tplt_visitor_free(one->visitor);
+    tplt_publish(NULL);
+}
+
+const struct tplt_holder* 
+tplt_vholder(const struct tplt* t, int type) {
+    if (t && type >= 0 && type < t->sz)
+        return t->p[type].holder;
+    return NULL;
+}
+
+void*
+tplt_vfind(const struct tplt* t, int type, uint32_t key) {
+    if (t && type >= 0 && type < t->sz) {
+        const struct tplt_visitor* vist = t->p[type].visitor;
+        if (vist) {
+            return tplt_visitor_find(vist, key);
         }
     }
-    free(self->p);
-    self->p = NULL;
-    self->sz = 0;
-    free(self);
-    self = NULL;
+    return NULL;
 }
 
 const struct tplt_holder* 
 tplt_get_holder(int type) {
-    if (self && type >= 0 && type < self->sz)
-        return self->p[type].holder;
-    return NULL;
+    return tplt_vholder(self, type);
 }
 
 const struct tplt_visitor* 
@@ -108,9 +174,5 @@ tplt_get_visitor(int type) {
 
 void* 
 tplt_find(int type, uint32_t key) {
-    const struct tplt_visitor* vist = tplt_get_visitor(type);
-    if (vist) {
-        return tplt_visitor_find(vist, key);
-    }
-    return NULL;
+    return tplt_vfind(self, type, key);
 }
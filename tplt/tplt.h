@@ -16,8 +16,20 @@ struct tplt_desc {
     const struct tplt_visitor_ops* vist;
 };
 
+// build and publish, the current version is kept if fail
 int tplt_init(const struct tplt_desc* desc, int sz);
 void tplt_fini();
+
+// build a version without touch the current, can call in other thread
+struct tplt* tplt_build(const struct tplt_desc* desc, int sz);
+// make t current, the old version is released
+void tplt_publish(struct tplt* t);
+// hold the current version, keep valid after next publish
+struct tplt* tplt_acquire();
+void tplt_release(struct tplt* t);
+const struct tplt_holder* tplt_vholder(const struct tplt* t, int type);
+void* tplt_vfind(const struct tplt* t, int type, uint32_t key);
+
 const struct tplt_holder* tplt_get_holder(int type);
 const struct tplt_visitor* tplt_get_visitor(int type);
 void* tplt_find(int type, uint32_t key);
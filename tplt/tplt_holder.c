@@ -3,6 +3,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /*
 struct readptr {
@@ -69,6 +75,42 @@ tplt_holder_load(const char* file, int elemsz) {
     return self; 
 }
 
+#ifndef _WIN32
+// map the file readonly, so the processes on one host share the page cache
+struct tplt_holder*
+tplt_holder_map(const char* file, int elemsz, size_t* mapsz) {
+    int fd = open(file, O_RDONLY);
+    if (fd == -1) {
+        TPLT_LOGERR("open fail");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < sizeof(struct tplt_holder)) {
+        TPLT_LOGERR("read tbl head fail");
+        close(fd);
+        return NULL;
+    }
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        TPLT_LOGERR("mmap fail");
+        return NULL;
+    }
+    struct tplt_holder* self = p;
+    if (_check(self, st.st_size, elemsz)) {
+        munmap(p, st.st_size);
+        return NULL;
+    }
+    *mapsz = st.st_size;
+    return self;
+}
+
+void
+tplt_holder_unmap(struct tplt_holder* self, size_t mapsz) {
+    munmap(self, mapsz);
+}
+#endif
+
 struct tplt_holder*
 tplt_holder_loadfromstream(const void* stream, int streamsz, int elemsz) {
     if (streamsz < sizeof(struct tplt_holder)) {
@@ -2,6 +2,7 @@
 #define __tplt_holder_h__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #pragma pack(1)
 struct tplt_holder {
@@ -26,6 +27,11 @@ struct tplt_holder {
 
 struct tplt_holder* tplt_holder_load(const char* file, int elemsz);
 struct tplt_holder* tplt_holder_loadfromstream(const void* stream, int streamsz, int elemsz);
+#ifndef _WIN32
+// readonly, free by tplt_holder_unmap
+struct tplt_holder* tplt_holder_map(const char* file, int elemsz, size_t* mapsz);
+void tplt_holder_unmap(struct tplt_holder* self, size_t mapsz);
+#endif
 
 void tplt_holder_free(struct tplt_holder* self);
 
@@ -31,3 +31,13 @@ void*
 tplt_visitor_find(const struct tplt_visitor* visitor, uint32_t key) {
     return visitor->ops->find(visitor, key);
 }
+
+void
+tplt_visitor_stat(const struct tplt_visitor* visitor, struct tplt_visitor_stat* st) {
+    st->strategy = "";
+    st->nelem = 0;
+    st->slots = 0;
+    if (visitor->ops->stat) {
+        visitor->ops->stat(visitor, st);
+    }
+}
@@ -11,9 +11,16 @@ struct tplt_visitor {
     void* data;
 };
 
+struct tplt_visitor_stat {
+    const char* strategy;
+    int nelem;
+    int slots; // entries of the index
+};
+
 struct tplt_visitor* tplt_visitor_create(const struct tplt_visitor_ops* ops, 
                                          struct tplt_holder* holder);
 void tplt_visitor_free(struct tplt_visitor* visitor);
 void* tplt_visitor_find(const struct tplt_visitor* visitor, uint32_t key);
+void tplt_visitor_stat(const struct tplt_visitor* visitor, struct tplt_visitor_stat* st);
 
 #endif
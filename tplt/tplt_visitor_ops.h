@@ -5,11 +5,13 @@
 
 struct tplt_holder;
 struct tplt_visitor;
+struct tplt_visitor_stat;
 
 struct tplt_visitor_ops {
     int   (*create)(struct tplt_visitor* visitor, struct tplt_holder* holder);
     void  (*free)(struct tplt_visitor* visitor);
     void* (*find)(const struct tplt_visitor* visitor, uint32_t key);
+    void  (*stat)(const struct tplt_visitor* visitor, struct tplt_visitor_stat* st);
 };
 
 #endif
@@ -57,10 +57,19 @@ _vec32_find(const struct tplt_visitor* visitor, uint32_t key) {
     return NULL;
 }
 
+static void
+_vec32_stat(const struct tplt_visitor* visitor, struct tplt_visitor_stat* st) {
+    const struct _vec32* vec = visitor->data;
+    st->strategy = "vec32";
+    st->nelem = vec->sz;
+    st->slots = vec->sz;
+}
+
 const struct tplt_visitor_ops g_tplt_visitor_vec32 = {
     _vec32_create,
     _vec32_free,
     _vec32_find,
+    _vec32_stat,
 };
 
 /*
@@ -89,7 +98,7 @@ _index32_create(struct tplt_visitor* visitor, struct tplt_holder* holder) {
 
     uint32_t max = key_max+1;
     void** p = malloc(sizeof(void*) * max);
-    memset(p, 0, sizeof(*p));
+    memset(p, 0, sizeof(void*) * max);
 
     ptr = holder->data;
     for (i=0; i<holder->nelem; ++i) {
@@ -123,8 +132,155 @@ _index32_find(const struct tplt_visitor* visitor, uint32_t key) {
     return NULL;
 }
 
+static void
+_index32_stat(const struct tplt_visitor* visitor, struct tplt_visitor_stat* st) {
+    const struct _index32* index = visitor->data;
+    int i, n = 0;
+    for (i=0; i<index->sz; ++i) {
+        if (index->p[i])
+            n++;
+    }
+    st->strategy = "index32";
+    st->nelem = n;
+    st->slots = index->sz;
+}
+
 const struct tplt_visitor_ops g_tplt_visitor_index32 = {
     _index32_create,
     _index32_free,
     _index32_find,
+    _index32_stat,
+};
+
+/*
+ * auto, dense index from the min key if the keys are compact,
+ * else sorted keys with branchless binary search.
+ * the first element win if the key repeat, same as vec32
+ */
+#define AUTO_DENSE_FACTOR 4 // slots <= nelem * factor
+
+struct _auto {
+    int dense;
+    int nelem;
+    uint32_t base; // min key if dense
+    int sz; // slots if dense, else nelem
+    uint32_t* keys; // sorted, if not dense
+    void** p;
+};
+
+struct _auto_sort {
+    uint32_t key;
+    int index;
+};
+
+static int
+_auto_cmp(const void* a, const void* b) {
+    const struct _auto_sort* x = a;
+    const struct _auto_sort* y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->index - y->index;
+}
+
+static int
+_auto_create(struct tplt_visitor* visitor, struct tplt_holder* holder) {
+    struct _auto* a = malloc(sizeof(*a));
+    memset(a, 0, sizeof(*a));
+    a->nelem = holder->nelem;
+    visitor->data = a;
+    if (holder->nelem <= 0)
+        return 0;
+
+    int i;
+    uint32_t key, key_min = UINT32_MAX, key_max = 0;
+    char* ptr = holder->data;
+    for (i=0; i<holder->nelem; ++i) {
+        key = *(uint32_t*)ptr;
+        if (key_min > key)
+            key_min = key;
+        if (key_max < key)
+            key_max = key;
+        ptr += holder->elemsz;
+    }
+    uint64_t span = (uint64_t)key_max - key_min + 1;
+    if (span <= (uint64_t)holder->nelem * AUTO_DENSE_FACTOR) {
+        a->dense = 1;
+        a->base = key_min;
+        a->sz = (int)span;
+        a->p = malloc(sizeof(void*) * a->sz);
+        memset(a->p, 0, sizeof(void*) * a->sz);
+        ptr = holder->data + holder->elemsz * (holder->nelem-1);
+        for (i=holder->nelem-1; i>=0; --i) {
+            key = *(uint32_t*)ptr;
+            a->p[key - key_min] = ptr;
+            ptr -= holder->elemsz;
+        }
+        return 0;
+    }
+    struct _auto_sort* tmp = malloc(sizeof(*tmp) * holder->nelem);
+    ptr = holder->data;
+    for (i=0; i<holder->nelem; ++i) {
+        tmp[i].key = *(uint32_t*)ptr;
+        tmp[i].index = i;
+        ptr += holder->elemsz;
+    }
+    qsort(tmp, holder->nelem, sizeof(*tmp), _auto_cmp);
+    a->keys = malloc(sizeof(uint32_t) * holder->nelem);
+    a->p = malloc(sizeof(void*) * holder->nelem);
+    int n = 0;
+    for (i=0; i<holder->nelem; ++i) {
+        if (n > 0 && a->keys[n-1] == tmp[i].key)
+            continue;
+        a->keys[n] = tmp[i].key;
+        a->p[n] = holder->data + holder->elemsz * tmp[i].index;
+        n++;
+    }
+    a->sz = n;
+    free(tmp);
+    return 0;
+}
+
+static void
+_auto_free(struct tplt_visitor* visitor) {
+    struct _auto* a = visitor->data;
+    if (a) {
+        free(a->keys);
+        free(a->p);
+        free(a);
+        visitor->data = NULL;
+    }
+}
+
+static void*
+_auto_find(const struct tplt_visitor* visitor, uint32_t key) {
+    const struct _auto* a = visitor->data;
+    if (a->dense) {
+        uint32_t i = key - a->base;
+        return i < (uint32_t)a->sz ? a->p[i] : NULL;
+    }
+    int n = a->sz;
+    if (n == 0)
+        return NULL;
+    const uint32_t* base = a->keys;
+    while (n > 1) {
+        int half = n / 2;
+        base = (base[half] <= key) ? base + half : base;
+        n -= half;
+    }
+    return *base == key ? a->p[base - a->keys] : NULL;
+}
+
+static void
+_auto_stat(const struct tplt_visitor* visitor, struct tplt_visitor_stat* st) {
+    const struct _auto* a = visitor->data;
+    st->strategy = a->dense ? "dense" : "sorted";
+    st->nelem = a->nelem;
+    st->slots = a->sz;
+}
+
+const struct tplt_visitor_ops g_tplt_visitor_auto = {
+    _auto_create,
+    _auto_free,
+    _auto_find,
+    _auto_stat,
 };
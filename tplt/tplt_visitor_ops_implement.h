@@ -16,8 +16,10 @@
 
 #define TPLT_VIST_VEC32 &g_tplt_visitor_vec32
 #define TPLT_VIST_INDEX32 &g_tplt_visitor_index32
+#define TPLT_VIST_AUTO &g_tplt_visitor_auto
 
 TPLT_VAR const struct tplt_visitor_ops g_tplt_visitor_vec32;
 TPLT_VAR const struct tplt_visitor_ops g_tplt_visitor_index32;
+TPLT_VAR const struct tplt_visitor_ops g_tplt_visitor_auto;
 
 #endif
@@ -11,6 +11,8 @@ struct player_holder {
     struct hashid hi;
     struct hashid hi2;
     struct player* p;
+    int* dirty; // index of dirty player, queue
+    int ndirty;
 };
 
 static struct player_holder* PH = NULL;
@@ -32,6 +34,8 @@ _allocplayers(int cmax, int hmax, int gmax) {
     freeid_init(&PH->fi, gmax*cmax, gmax*hmax);
     hashid_init(&PH->hi, gmax*cmax, gmax*hmax);
     hashid_init(&PH->hi2, gmax*cmax, gmax*hmax);
+    PH->dirty = malloc(sizeof(int) * gmax*cmax);
+    PH->ndirty = 0;
 }
 void
 _freeplayers() {
@@ -39,6 +43,7 @@ _freeplayers() {
         freeid_fini(&PH->fi);
         hashid_fini(&PH->hi);
         hashid_fini(&PH->hi2);
+        free(PH->dirty);
         free(PH->p);
         free(PH);
         PH = NULL;
@@ -145,7 +150,42 @@ _freeplayer(struct player* p) {
         p->data.charid = 0; 
     }
     p->data.name[0] = '\0';
+    p->dirty = 0; // the link is dropped at next foreach
     p->status = PS_FREE;
     p->gid = 0;
     p->cid = 0;
 }
+
+void
+_dirtyplayer(struct player* p, int flag) {
+    p->dirty |= flag;
+    if (!p->dirty_link) {
+        p->dirty_link = 1;
+        PH->dirty[PH->ndirty++] = p - PH->p;
+    }
+}
+
+// call cb for the first max dirty players (all if max <= 0), 
+// the dirty flag is cleared after cb, return the count of cb
+int
+_foreach_dirtyplayer(int max, void (*cb)(struct player* p, void* ud), void* ud) {
+    if (PH == NULL)
+        return 0;
+    int n = PH->ndirty;
+    if (max > 0 && max < n)
+        n = max;
+    int count = 0;
+    int i;
+    for (i=0; i<n; ++i) {
+        struct player* p = &PH->p[PH->dirty[i]];
+        p->dirty_link = 0;
+        if (p->dirty && p->status != PS_FREE) {
+            cb(p, ud);
+            count++;
+        }
+        p->dirty = 0;
+    }
+    PH->ndirty -= n;
+    memmove(PH->dirty, PH->dirty + n, sizeof(int) * PH->ndirty);
+    return count;
+}
@@ -51,14 +51,22 @@ _player_gradeid(uint16_t level) {
     return grade;
 }
 
+// dirty field, flush to db by world (write behind)
+#define PD_COIN  0x01 // coin, diamond
+#define PD_EXP   0x02 // level, exp, score
+#define PD_ROLES 0x04 // role, ownrole
+#define PD_RINGS 0x08 // ringdata
+
 // player
 struct player {
     uint16_t gid;
     uint16_t cid;
     int status;
     int createchar_times;
-    int roomid;
+    int roomid; // waiter id if PS_WAITING, room id if PS_CREATING, see gamematch
     int cu_flag; // see CU_GRADE
+    int dirty; // see PD_*
+    int dirty_link; // in the dirty list
     struct chardata data;
 };
 
@@ -71,5 +79,7 @@ struct player* _allocplayer(uint16_t gid, int cid);
 void _freeplayer(struct player* p);
 int  _hashplayeracc(struct player* p, uint32_t accid);
 int  _hashplayer(struct player* p, uint32_t charid);
+void _dirtyplayer(struct player* p, int flag);
+int  _foreach_dirtyplayer(int max, void (*cb)(struct player* p, void* ud), void* ud);
 
 #endif
@@ -18,6 +18,7 @@
 #define PDB_CHARID 6
 #define PDB_CREATE 7
 #define PDB_BINDCHARID 8
+#define PDB_MIGRATE 9 // convert the legacy fields to the binary data, internal
 
 struct player;
 
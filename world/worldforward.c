@@ -0,0 +1,10 @@
+#include "worldhelper.h"
+#include "forward_batch.h"
+
+// the forward to gate of all world services, they are in one reactor like the players
+static struct fwbatch FB;
+
+void
+_forward_togate(int connid, struct UM_FORWARD* fw) {
+    fwbatch_sendforward(&FB, connid, fw);
+}
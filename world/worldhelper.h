@@ -14,11 +14,14 @@ struct player_message {
     struct player* p;
 };
 
+// batch the forwards to one gate in this loop, see forward_batch.h
+void _forward_togate(int connid, struct UM_FORWARD* fw);
+
 static inline void
 _forward_toplayer(struct player* p, struct UM_FORWARD* fw) {
     const struct sc_node* n = sc_node_get(HNODE_ID(NODE_GATE, p->gid));
     if (n) {
-        UM_SENDFORWARD(n->connid, fw);
+        _forward_togate(n->connid, fw);
     }
 }
 
@@ -40,7 +43,7 @@ static inline void
 _forward_connlogout(const struct sc_node* node, int cid, int32_t error) {
     UM_DEFFORWARD(fw, cid, UM_LOGOUT, lo);
     lo->error = error;
-    UM_SENDFORWARD(node->connid, fw);
+    _forward_togate(node->connid, fw);
 }
 
 static inline int
@@ -54,6 +57,7 @@ _decode_playermessage(struct node_message* nm, struct player_message* pm) {
     }
     pm->hn = hn; 
     pm->um = &fw->wrap;
+    pm->sz = fw->wrap.msgsz;
     pm->p = p;
     return 0;
 }